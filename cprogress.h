@@ -34,9 +34,46 @@
   | cprogress_t cprogress = cprogress_create(fmt: string, thread_count: int);
 
   [fmt] defines what it shows while displaying, see FORMAT below.
-  [thread_count] defines how many progresses will be shown, should be bigger than zero.
+  [thread_count] defines how many progresses are there from the beginning, addressed by
+  thread_index from 0 to thread_count - 1. It can be zero if you only use the pool below.
   Returns an instance object. Any other APIs rely on it.
   Errors are indicated with [cprogress.error], which is zero when everything works fine.
+  The format is read twice, to size then to fill one single allocation that holds the
+  parsed format, the first thread_count (at least CPROGRESS_THREADINFO_SEGMENT_MINLEN)
+  thread data and the event queue. A format has at most CPROGRESS_DISPLAYCHUNK_MAXLEN chunks,
+  literals and elements alike, more fail with CPROGRESS_ERROR_INVAL.
+
+  The format can also be given as a ready-made table of chunks, terminated with a zeroed one,
+  which is then neither parsed, copied nor freed:
+
+  | cprogress_t cprogress = cprogress_create_withchunks(displaychunks: const cprogress_displaychunk_t *, thread_count: int);
+
+  In C++, cprogress.hpp makes such tables from format strings at compile time.
+
+  A format used by many instances is better parsed once:
+
+  | cprogress_format_t *format = cprogress_format_create(fmt: string, error: cprogress_error_t *);
+  | cprogress_t cprogress = cprogress_create_withformat(format, thread_count: int);
+  | cprogress_format_release(format);
+
+  Returns NULL on error, with the reason in [*error] if given. Formats are reference counted,
+  each instance holds a reference until cprogress_destroy(...), so the creator may release
+  its own right away. cprogress_format_retain(...) takes another one.
+
+  The format of an instance created from a string or a table of chunks, [cprogress.formats[0]],
+  is carved in its arena and goes with it, so it is not shareable: don't retain it, and
+  cprogress_create_withformat(...) and cprogress_attachformat(...) refuse it.
+
+  Threads of one instance can also be shown with different formats, e.g. downloads with
+  "$=t $B $R" next to compute shards with "$=t $c $e":
+
+  | int format_index = cprogress_attachformat(cprogress, format);
+  | cprogress_updatethread_format(cprogress, thread_index, format_index);
+
+  The instance takes a reference. cprogress_attachformat(...) returns CPROGRESS_UNDEF when
+  the instance already holds CPROGRESS_FORMAT_MAXLEN formats or the format is pinned to an arena, call it on the rendering thread
+  or before rendering starts. Format 0 is the one the instance was created with, and every
+  thread goes back to it when started.
 
   Then you may want to update every progress with:
 
@@ -52,9 +89,67 @@
 
   | cprogress_updatethread_title(cprogress: cprogress_t *, thread_index: int, const char *title);
 
-  [title] will be duplicated so it's safe to free it after calling.
+  [title] will be copied (truncated to CPROGRESS_TITLE_MAXLEN - 1 bytes) so it's safe to
+  free it after calling.
+
+  or update with item counts, the percentage is derived from them:
+
+  | cprogress_updatethread_progress(cprogress: cprogress_t *, thread_index: int, done: uint64_t, total: uint64_t);
+
+  Updaters can be called from anywhere e.g. any thread, but only one thread at a time should
+  update the same thread_index. Updaters never take a lock: every thread data is guarded by
+  a seqlock, the renderer retries reading until it gets a consistent snapshot.
+
+  For tight loops that make progress item by item, use a thread-local accumulator instead,
+  which only publishes to the shared data every [flush_count] items or every [flush_ns]
+  nanoseconds, whichever comes first (zero disables either threshold):
+
+  | cprogress_local_t local = cprogress_local_create(cprogress, thread_index, total, flush_count, flush_ns);
+  | for (...) cprogress_local_add(&local, 1);
+  | cprogress_local_flush(&local);
+
+  [local] is owned by the calling thread and must not be shared. Reaching [total] always
+  publishes immediately.
 
-  Updaters can be called from anywhere e.g. any thread.
+  When tasks come and go, let the instance hand out thread_index instead:
+
+  | int thread_index = cprogress_acquire(cprogress: cprogress_t *);
+  | ...
+  | cprogress_release(cprogress: cprogress_t *, thread_index: int);
+
+  cprogress_acquire(...) returns a started thread_index, growing the instance when all are
+  taken (existing thread data never moves, so rendering goes on meanwhile), or
+  CPROGRESS_UNDEF when out of memory. cprogress_release(...) finishes it and gives it back
+  for reuse. Both are lock-free and O(1). Don't release thread_index from cprogress_create(...)
+  unless they are all meant to be managed by the pool.
+
+  Tasks can be nested, e.g. jobs made of stages made of shards:
+
+  | cprogress_attachthread(cprogress, thread_index, parent_index: int, weight: uint32_t);
+
+  A parent shows the weighted progress of its children instead of its own percentage.
+  Every update moves only the ancestors of the updated thread, by the delta, so it costs
+  O(depth) no matter how many siblings there are. Attach and detach
+  (cprogress_detachthread(...)) while the subtree is not being updated. Children are drawn
+  indented under their parent, and a subtree can be folded to its parent line with:
+
+  | cprogress_collapsethread(cprogress, thread_index, is_collapsed: int);
+
+  A parent does not stop by itself when its children finish; stop it as usual.
+
+  When there is no telling how much is left, e.g. walking a directory, switch the thread to
+  indeterminate mode:
+
+  | cprogress_updatethread_indeterminate(cprogress, thread_index, is_indeterminate: int);
+
+  Its bar bounces instead of filling, and its percentage is not shown. It can still count
+  items with cprogress_updatethread_progress(cprogress, thread_index, done, 0), which $r
+  shows as items per second. To only tell that it is alive, bump its counter with
+
+  | cprogress_tickthread(cprogress, thread_index);
+
+  which is a plain store, no seqlock and no clock. Its spinner (see $s below) and its bar
+  stop moving when neither happened for CPROGRESS_SPINNER_STALL_MS milliseconds.
 
   Then in your main thread, you can write something like:
 
@@ -63,6 +158,196 @@
   |   cprogress_waitfps(fps: int);
   | }
 
+  Events (see cprogress_subscribeevent(...)) are queued by updaters and delivered by
+
+  | cprogress_dispatchevents(cprogress: cprogress_t *);
+
+  exactly once each and in order, on the thread that calls it. Call it from one thread only,
+  e.g. right after cprogress_render(...). cprogress_render_tillcomplete(...) does this for you.
+  If more than CPROGRESS_EVENTQUEUE_LENGTH events pile up undispatched, new ones are dropped
+  rather than blocking the updater.
+
+  Each event type takes up to CPROGRESS_SUBSCRIBER_MAXLEN subscribers, optionally with userdata:
+
+  | cprogress_subscribeevent_userdata(cprogress, type, listener, userdata: void *);
+  | cprogress_unsubscribeevent(cprogress, type, listener, userdata: void *);
+
+  cprogress_subscribeevent(cprogress, type, func) keeps working as it always has, next to
+  them: it replaces whatever was set by it before for the type, and NULL clears it. Both
+  return CPROGRESS_ERROR_BUFFUL when the type has no room left.
+
+  and whoever wants everything at once can take events in arrays, one call per dispatched
+  batch instead of one call per event:
+
+  | cprogress_subscribebatch(cprogress, func, userdata: void *);
+
+  (Un)subscribe on the dispatching thread, or before dispatching starts.
+
+  Memory is taken from an allocator, aligned_alloc(3) and free(3) by default. To route it
+  elsewhere, e.g. to an arena or a pool, hand one to the instance or format being created:
+
+  | cprogress_allocator_t allocator = { alloc, free, userdata };
+  | cprogress = cprogress_create_withallocator(fmt: const char *, thread_count: int, &allocator);
+  | format = cprogress_format_create_withallocator(fmt: const char *, &error, &allocator);
+
+  with [alloc] as void *(size_t size, size_t align, void *userdata), returning NULL when out
+  of memory, and [free] as void (void *ptr, size_t size, void *userdata), given the same
+  size. The instance or format keeps a copy of it, and uses that copy for everything it
+  allocates or frees later, e.g. growing the pool. NULL takes the default one.
+
+  The default one, taken by every other way of creating, can be replaced process-wide as a
+  fallback, e.g. by a program that owns all of its libraries' memory:
+
+  | cprogress_setdefaultallocator(&allocator);
+
+  NULL restores the built-in one. It is not synchronized and changes what every instance and
+  format created afterwards uses, whoever creates them, so prefer the above.
+
+  Programs that must not use the heap at all can hand their own storage instead, by defining
+  before including the implementation:
+
+  | static char storage[1 << 20];
+  | #define CPROGRESS_STATIC_STORAGE storage
+  | #define CPROGRESS_STATIC_STORAGE_LENGTH sizeof(storage)
+
+  The default allocator then takes memory from [storage] and never gives it back, so size
+  it for everything that is ever created. malloc(3) is not called by cprogress itself, nor
+  through stdio: cprogress_writetrace(...) and the export write with write(2) from buffers
+  of their own, and the frame goes out the same way after fflush(3) of stdout.
+
+  Either way, nothing is allocated once instances and formats are created: updating,
+  rendering and dispatching never touch the allocator. The only exception is the pool
+  growing past the most thread_index it ever had at once, see cprogress_acquire(...).
+  Lines wider than CPROGRESS_CONSOLE_MAXWIDTH columns are cut, so that the frame buffer can
+  be set aside up front. test/test_noalloc.sh checks this.
+
+  A frame is gathered in a buffer of CPROGRESS_FRAMEBUFFER_LENGTH bytes and handed to write(2)
+  on the file descriptor of stdout at once, after flushing whatever the program has printed
+  with stdio. What rendering costs is counted as it goes:
+
+  | cprogress_stats_t stats;
+  | cprogress_stats(cprogress, &stats);
+
+  gives frames rendered, bytes and write(2) calls, the last console width and how long
+  frames took: in total, at the 50th to 99.9th percentile (from a histogram within about 3%)
+  and at most. Frame times are read from CPROGRESS_FRAME_CLOCK at both ends of
+  cprogress_render(...), so they are as coarse as it is. render_ns / elapsed_ns is the share
+  of time the renderer took. Deadlines are only known with a frame rate:
+
+  | cprogress_setframerate(cprogress, fps: int);
+
+  which cprogress_render_tillcomplete(...) sets itself. Then frames taking longer than
+  1 / fps count as missed deadlines, and each 1 / fps passing without a frame as skipped.
+  Call cprogress_stats(...) on the rendering thread.
+
+  For tracing in production, define CPROGRESS_USDT before including the implementation to
+  put in USDT probes (sys/sdt.h from systemtap). Each is a single nop until a tracer
+  attaches, so they can stay in release builds. Provider "cprogress", with arguments:
+    thread_start(thread_index, start_count)
+    thread_update(thread_index, percentage in CPROGRESS_ROLLUP_SCALE, done, total)
+    thread_finish(thread_index, stop_count)
+    frame_begin(frame_index, now_ns)
+    frame_end(frame_index, render_ns, line_count)
+    event_push(type, thread_index, is_dropped): queued by an updater
+    event_emit(type, thread_index): delivered to subscribers
+  e.g. frame times as a histogram:
+
+  | bpftrace -e 'usdt:./program:cprogress:frame_end { @ns = hist(arg1); }'
+
+  Without CPROGRESS_USDT they are not compiled at all.
+
+  To see stragglers and load imbalance afterwards, slots can be traced into a timeline:
+
+  | cprogress_enabletrace(cprogress, records_length: size_t);
+  | ... run and render as usual ...
+  | cprogress_writetrace(cprogress, "trace.json");
+
+  Every start, title change and finish is recorded by the updater, and progress once per
+  frame by the renderer when it moved, into records allocated once by
+  cprogress_enabletrace(...); call it before any slot starts. Recording is lock-free, one
+  fetch and add per record, and records past [records_length] are dropped and counted.
+  The file is in the Chrome trace event format for ui.perfetto.dev or chrome://tracing:
+  a track per slot, a slice per title, and progress as a counter.
+
+  For dashboards, the renderer can also export all slots at a cadence of its own:
+
+  | cprogress_enableexport(cprogress, CPROGRESS_EXPORT_JSONLINES, "progress.jsonl", interval_ms: int);
+  | cprogress_enableexport(cprogress, CPROGRESS_EXPORT_PROMETHEUS, "textfile/job.prom", interval_ms: int);
+  | cprogress_writeexport(cprogress);
+
+  cprogress_render(...) exports once [interval_ms] of frame time has passed, after the frame
+  is out; cprogress_writeexport(...) does it right away, from the thread that renders, and
+  cprogress_render_tillcomplete(...) once more at the end. Slots are read the same way as
+  for the screen, so updaters are never waited for, and rates and eta are sampled for the
+  export even when the format doesn't show them.
+  JSON Lines get a line per running slot, and one more when a slot stops, with time, slot,
+  parent, title, state (running, finished or aborted), percentage, done, total, rate,
+  elapsed_s and eta_s, appended to the file. Prometheus gets every slot that ever started
+  in the text exposition format, e.g. for node_exporter's textfile collector:
+  cprogress_slot_info with title, parent and state as labels, then cprogress_running,
+  _percentage, _done, _total, _rate, _elapsed_seconds and _eta_seconds by slot. It is
+  written to [path].tmp and renamed over [path], so it is never read half written.
+
+  A run can be recorded to be watched again later:
+
+  | cprogress_enablerecord(cprogress, "run.rec");
+  | cprogress_flushrecord(cprogress);
+
+  Each frame cprogress_render(...) appends the slots that changed since the frame before,
+  as varints of what changed only: starts, stops, titles, and progress once it moved by
+  1 / CPROGRESS_RECORD_STEPS. So the size goes with how far slots get rather than with the
+  frame rate, about CPROGRESS_RECORD_STEPS times a byte or two per slot run through, i.e. low
+  MB for 1,000 slots. Frames are gathered in memory and written every
+  CPROGRESS_RECORD_FLUSH_MS, by cprogress_flushrecord(...) and at cprogress_destroy(...).
+  The formats attached so far are kept, and which one each slot uses, so attach any before
+  enabling it. tools/cprogress-replay.c draws it again, at any speed, with the same formats
+  or another one in place of the one it was created with:
+
+  | $ cprogress-replay [-s speed] [-r fps] [-f format] run.rec
+
+  It draws through cprogress_renderat(cprogress, now_ns: uint64_t), which is
+  cprogress_render(...) at a given frame time, so that rates and eta follow recorded time.
+
+  Workers in other processes, e.g. forked ones, can update an instance directly when it is
+  created in shared memory:
+
+  | cprogress = cprogress_create_shared(fmt: const char *, thread_count: int);
+
+  Slots, titles inline, the event queue and a trace (when enabled) then live in one
+  MAP_SHARED mapping, so that children forked afterwards update their slot with plain
+  atomics, no syscall, and the parent renders and dispatches as usual. Set it all up,
+  i.e. start, title, attach and enable trace, before forking. Slots are fixed to
+  [thread_count]: the pool doesn't grow since other processes would not see new segments.
+  Children leave with _exit(2) without destroying it.
+  A worker that dies in the middle of an update can't corrupt the display: the renderer
+  waits up to CPROGRESS_SNAPSHOT_MAXRETRY tries for a write to end and then draws the slot
+  as it is. Once the parent learns the worker is gone, e.g. from waitpid(2),
+
+  | cprogress_recoverthread(cprogress, thread_index: int);
+
+  closes the write it left open and stops the slot, as cprogress_abortthread(...) would.
+  A worker that died in the middle of queueing an event leaves a position it claimed but
+  never wrote, which would hold back every later event. Once recovered, a position claimed
+  before that and still not taken after CPROGRESS_EVENTQUEUE_MAXSTALL dispatches is skipped
+  as dropped. A worker only writes a cell it took for its position, so one that was merely
+  slow finds its position skipped and drops its event, it never writes over a later one.
+
+  The same, in a segment any process of the user can open by name:
+
+  | cprogress = cprogress_create_named(fmt: const char *, thread_count: int, name: const char *);
+
+  [name] is as for shm_open(3), e.g. "/myjob", shorter than CPROGRESS_SHAREDNAME_MAXLEN.
+  The process doesn't need to render at all; tools/cprogress-top.c attaches to it from
+  another shell, maps it read-only and draws it at its own frame rate:
+
+  | $ cprogress-top [-r fps] [-f format] /myjob
+
+  The segment starts with a cprogress_sharedheader_t telling where the slots are, and is
+  unlinked by cprogress_destroy(...) unless another instance has taken the name since.
+  A name in use by a process still alive fails with CPROGRESS_ERROR_EXIST; one left behind
+  by a run that crashed is unlinked and made anew. A viewer has to be built with the same cprogress.h and
+  settings, it refuses the segment otherwise.
+
   This is actually a basic concept of immediate mode ui. By calling cprogress_stillrunning(...),
   program knows whether the whole process is complete. There are two reasons for returning
   false by cprogress_stillrunning(...):
@@ -87,6 +372,16 @@
       In this case, arg1 is made use of displaying the progress that is done
       and width is a necessary arg.
     p: prints percentage, in float
+    r: prints rate, items per second when updated with counts, or percentage per second
+    R: prints rate in bytes per second, for counts in bytes
+    e: prints estimated time left
+    T: prints elapsed time
+    s: prints a spinner, one of CPROGRESS_SPINNER_GLYPHS every
+      CPROGRESS_SPINNER_FRAMES_PER_GLYPH frames
+    c: prints counts as done/total, e.g. 12,345/1,000,000
+    B: prints counts in bytes as done/total, e.g. 1.2 GiB/4.0 GiB
+  c and B only show done when total is unknown, i.e. updated with percentage or with zero
+  total.
   while for [width]:
     when as an integer: limits length and pad tailing spaces when not satisfied
     when equals to "=": auto span, like [flex: 1] in flex boxes in CSS
@@ -94,6 +389,12 @@
 
   Any other characters or syntaxes will be ignored and be output directly.
 
+  Time related conversions are sampled by the renderer once per frame, rates are smoothed
+  with an exponential moving average over about CPROGRESS_RATE_TAU_MS milliseconds. Updaters
+  never read the clock for them. The clock is read only once per frame, from
+  CPROGRESS_FRAME_CLOCK (CLOCK_MONOTONIC by default, define it as CLOCK_MONOTONIC_COARSE
+  before including the implementation for a cheaper one), and all lines of a frame share it.
+
   The example above will output like:
 
     |                                                                  |
@@ -147,18 +448,138 @@
 
 
 
+#include "stddef.h"
 #include "stdint.h"
 
+#ifdef __cplusplus
+extern "C" {
+#endif
 
-#define CPROGRESS_UNDEF (-1)
 
+#define CPROGRESS_UNDEF (-1)
 
-/* module: stralloc */
-typedef struct {
-  char *buffer;
-  size_t length;
-  size_t size; /* indicates max length */
-} cprogress_stralloc_t;
+#ifndef CPROGRESS_TITLE_MAXLEN
+#define CPROGRESS_TITLE_MAXLEN 64
+#endif
+
+/* each computed chunk text has this many bytes, enough for two grouped 64-bit counts */
+#define CPROGRESS_CHUNKSTRING_MAXLEN 64
+
+/* chunks of one format, not counting the terminating one; their widths are measured on the stack */
+#ifndef CPROGRESS_DISPLAYCHUNK_MAXLEN
+#define CPROGRESS_DISPLAYCHUNK_MAXLEN 64
+#endif
+
+/* must be a power of 2 */
+#ifndef CPROGRESS_EVENTQUEUE_LENGTH
+#define CPROGRESS_EVENTQUEUE_LENGTH 1024
+#endif
+
+/* dispatches a cell left claimed by a recovered worker holds back the queue before it is skipped */
+#ifndef CPROGRESS_EVENTQUEUE_MAXSTALL
+#define CPROGRESS_EVENTQUEUE_MAXSTALL 16
+#endif
+
+/* time constant of rate smoothing */
+#ifndef CPROGRESS_RATE_TAU_MS
+#define CPROGRESS_RATE_TAU_MS 3000
+#endif
+
+/* spinner animation, each glyph is copied as is and must be one column wide */
+#ifndef CPROGRESS_SPINNER_GLYPHS
+#define CPROGRESS_SPINNER_GLYPHS { "|", "/", "-", "\\" }
+#endif
+
+#ifndef CPROGRESS_SPINNER_GLYPH_MAXLEN
+#define CPROGRESS_SPINNER_GLYPH_MAXLEN 8
+#endif
+
+#ifndef CPROGRESS_SPINNER_FRAMES_PER_GLYPH
+#define CPROGRESS_SPINNER_FRAMES_PER_GLYPH 3
+#endif
+
+/* the spinner freezes when the thread shows no sign of life for this long */
+#ifndef CPROGRESS_SPINNER_STALL_MS
+#define CPROGRESS_SPINNER_STALL_MS 2000
+#endif
+
+/* rolled up progress is counted in fixed point, this is 100% */
+#define CPROGRESS_ROLLUP_SCALE 1000000
+
+/* thread data are stored in segments, the first one holds at least this many */
+#ifndef CPROGRESS_THREADINFO_SEGMENT_MINLEN
+#define CPROGRESS_THREADINFO_SEGMENT_MINLEN 16
+#endif
+
+/* each segment doubles the capacity */
+#ifndef CPROGRESS_THREADINFO_SEGMENT_MAXLEN
+#define CPROGRESS_THREADINFO_SEGMENT_MAXLEN 24
+#endif
+
+/* lines are cut at this many columns on wider consoles */
+#ifndef CPROGRESS_CONSOLE_MAXWIDTH
+#define CPROGRESS_CONSOLE_MAXWIDTH 512
+#endif
+
+/* bytes a frame is gathered in before write(2), it holds at least one line of CPROGRESS_CONSOLE_MAXWIDTH */
+#ifndef CPROGRESS_FRAMEBUFFER_LENGTH
+#define CPROGRESS_FRAMEBUFFER_LENGTH 16384
+#endif
+
+/* render time histogram: 1 << CPROGRESS_STATS_SUBBUCKET_BITS buckets per power of two, i.e. within
+   about 3%, up to 1 << CPROGRESS_STATS_MAXBITS ns */
+#define CPROGRESS_STATS_SUBBUCKET_BITS 5
+#define CPROGRESS_STATS_MAXBITS 40
+#define CPROGRESS_STATS_HISTOGRAM_LENGTH ((CPROGRESS_STATS_MAXBITS - CPROGRESS_STATS_SUBBUCKET_BITS + 1) << CPROGRESS_STATS_SUBBUCKET_BITS)
+
+/* bytes cprogress_writetrace(...) gathers on its stack before write(2) */
+#ifndef CPROGRESS_TRACEBUFFER_LENGTH
+#define CPROGRESS_TRACEBUFFER_LENGTH 4096
+#endif
+
+/* path of cprogress_enableexport(...), including the terminating zero */
+#ifndef CPROGRESS_EXPORTPATH_MAXLEN
+#define CPROGRESS_EXPORTPATH_MAXLEN 256
+#endif
+
+/* bytes an export is gathered in before write(2) */
+#ifndef CPROGRESS_EXPORTBUFFER_LENGTH
+#define CPROGRESS_EXPORTBUFFER_LENGTH 16384
+#endif
+
+/* record: progress is logged when it moves by 1 / CPROGRESS_RECORD_STEPS, or when the slot stops */
+#ifndef CPROGRESS_RECORD_STEPS
+#define CPROGRESS_RECORD_STEPS 1000
+#endif
+
+/* bytes a record is gathered in, written out when nearly full or every CPROGRESS_RECORD_FLUSH_MS */
+#ifndef CPROGRESS_RECORDBUFFER_LENGTH
+#define CPROGRESS_RECORDBUFFER_LENGTH 65536
+#endif
+
+#ifndef CPROGRESS_RECORD_FLUSH_MS
+#define CPROGRESS_RECORD_FLUSH_MS 1000
+#endif
+
+/* name of a segment from cprogress_create_named(...), including the terminating zero */
+#ifndef CPROGRESS_SHAREDNAME_MAXLEN
+#define CPROGRESS_SHAREDNAME_MAXLEN 64
+#endif
+
+/* formats an instance holds, including the one it was created with */
+#ifndef CPROGRESS_FORMAT_MAXLEN
+#define CPROGRESS_FORMAT_MAXLEN 16
+#endif
+
+/* per event type, and for batch subscribers */
+#ifndef CPROGRESS_SUBSCRIBER_MAXLEN
+#define CPROGRESS_SUBSCRIBER_MAXLEN 8
+#endif
+
+/* how many events a batch subscriber receives per call at most */
+#ifndef CPROGRESS_EVENTBATCH_MAXLEN
+#define CPROGRESS_EVENTBATCH_MAXLEN 256
+#endif
 
 
 struct cprogress;
@@ -170,6 +591,7 @@ typedef enum {
   CPROGRESS_ERROR_INVAL = 1,
   CPROGRESS_ERROR_BUFFUL,
   CPROGRESS_ERROR_INTERNAL,
+  CPROGRESS_ERROR_EXIST, /* a name already taken by a live process */
 } cprogress_error_t;
 
 
@@ -180,6 +602,15 @@ typedef enum {
   CPROGRESS_DISPLAYCHUNK_TITLE,
   CPROGRESS_DISPLAYCHUNK_BAR,
   CPROGRESS_DISPLAYCHUNK_PERCENTAGE,
+  CPROGRESS_DISPLAYCHUNK_RATE,
+  CPROGRESS_DISPLAYCHUNK_BYTERATE,
+  CPROGRESS_DISPLAYCHUNK_ETA,
+  CPROGRESS_DISPLAYCHUNK_ELAPSED,
+  CPROGRESS_DISPLAYCHUNK_SPINNER,
+  CPROGRESS_DISPLAYCHUNK_COUNT,
+  CPROGRESS_DISPLAYCHUNK_BYTES,
+
+  CPROGRESS_DISPLAYCHUNK_TYPE_LENGTH, /* only use internally */
 } cprogress_displaychunk_type_t;
 
 typedef struct {
@@ -192,31 +623,40 @@ typedef struct {
 
   int is_autospan;
   size_t span_width;
-
-  /* cache */
-  size_t display_width;
 } cprogress_displaychunk_t;
 
-#define cprogress_displaychunk_foreach(cp, name) for (cprogress_displaychunk_t *name = (cp)->displaychunks; name->type; ++name)
-
-
-/* threadinfo */
-typedef struct {
-  /* persistent */
-  int is_valid; /* indicate if it's a EOF */
-  int thread_index;
+/* never written after creation, so a table can be shared and kept in read-only memory */
+#define cprogress_format_displaychunk_foreach(format, name) \
+  for (const cprogress_displaychunk_t *name = (format)->displaychunks; name->type; ++name)
+#define cprogress_displaychunk_foreach(cp, name) cprogress_format_displaychunk_foreach((cp)->formats[0], name)
 
-  int is_running;
-  char *title;
-  float percentage;
 
-  /* internal */
-  int is_just_stopped;
-} cprogress_threadinfo_t;
+/* allocator: where instances and formats take memory from, see cprogress_create_withallocator(...) */
+typedef void *(cprogress_alloc_func_t (size_t size, size_t align, void *userdata)); /* NULL when out of memory */
+typedef void (cprogress_free_func_t (void *ptr, size_t size, void *userdata)); /* size as allocated */
 
-#define cprogress_getthreadinfo(cp, thread_index) ((cp)->threadinfos[thread_index])
-#define cprogress_threadinfo_getindex(threadinfo) ((threadinfo)->thread_index)
-#define cprogress_threadinfo_foreach(cp, name) for (cprogress_threadinfo_t *name = (cp)->threadinfos; name->is_valid; ++name)
+typedef struct {
+  cprogress_alloc_func_t *alloc;
+  cprogress_free_func_t *free;
+  void *userdata;
+} cprogress_allocator_t;
+
+
+/* format: a parsed format, shared by instances and threads, see cprogress_format_create(...) */
+typedef struct cprogress_format {
+  uint32_t refcount; /* atomic */
+  void *block; /* freed with the last reference, NULL when it lives elsewhere e.g. in an arena */
+  size_t block_size;
+  cprogress_allocator_t allocator; /* block came from it */
+  int is_pinned; /* carved in an instance's arena, it goes with the instance and can't be shared */
+
+  int has_autospan_element;
+  uint32_t displaychunk_types; /* 1 << type of every chunk */
+  size_t displaychunks_length; /* including the terminating one */
+  cprogress_displaychunk_t *displaychunks;
+  size_t literals_length;
+  char *literals;
+} cprogress_format_t;
 
 
 /* subscribe */
@@ -231,33 +671,373 @@ typedef enum {
 } cprogress_event_type_t;
 
 typedef void (cprogress_eventsubscriber_func_t (struct cprogress *cprogress, cprogress_event_type_t type, int thread_index));
+typedef void (cprogress_eventlistener_func_t (struct cprogress *cprogress, cprogress_event_type_t type, int thread_index, void *userdata));
+
+typedef struct {
+  cprogress_eventsubscriber_func_t *func; /* either one is set */
+  cprogress_eventlistener_func_t *listener;
+  void *userdata;
+} cprogress_eventsubscriber_t;
+
+
+/* eventqueue: bounded lock-free MPSC ring, filled by updaters, drained by the dispatcher */
+typedef struct {
+  cprogress_event_type_t type;
+  int thread_index;
+} cprogress_event_t;
+
+typedef void (cprogress_eventbatch_func_t (struct cprogress *cprogress, const cprogress_event_t *events, size_t events_length, void *userdata));
+
+typedef struct {
+  cprogress_eventbatch_func_t *func;
+  void *userdata;
+} cprogress_eventbatchsubscriber_t;
+
+/* seq of a cell taken by the updater of that position, being written */
+#define CPROGRESS_EVENTCELL_WRITING (1ULL << 63)
+
+typedef struct {
+  uint64_t seq; /* position this cell is ready for, see cprogress_pushevent(...) */
+  cprogress_event_t event; /* only written by the updater holding the cell */
+} cprogress_eventcell_t;
+
+typedef struct {
+  uint64_t head; /* next position to push, shared by all updaters */
+  char padding[64 - sizeof(uint64_t)]; /* keep updaters off the dispatcher's cache line */
+  uint64_t tail; /* next position to pop, only touched by the dispatcher */
+  uint64_t dropped_count;
+  uint64_t recovered_head; /* cells before it may be skipped, see cprogress_recoverevents(...) */
+  uint32_t stalled_count; /* dispatches the cell at [tail] was claimed but not written */
+  size_t cells_length;
+  cprogress_eventcell_t cells[];
+} cprogress_eventqueue_t;
+
+
+/* trace: lifecycle of every slot for a timeline, see cprogress_enabletrace(...) */
+typedef enum {
+  CPROGRESS_TRACE_START = 1,
+  CPROGRESS_TRACE_TITLE,
+  CPROGRESS_TRACE_PROGRESS, /* sampled by the renderer once per frame, when it moved */
+  CPROGRESS_TRACE_FINISH,
+} cprogress_trace_type_t;
+
+typedef struct {
+  uint32_t is_ready; /* set last, records still being written are skipped */
+  cprogress_trace_type_t type;
+  int thread_index;
+  float percentage;
+  uint64_t ns; /* from CPROGRESS_FRAME_CLOCK */
+  char title[CPROGRESS_TITLE_MAXLEN];
+} cprogress_tracerecord_t;
+
+typedef struct {
+  uint64_t length; /* claimed by fetch and add, past records_length they are dropped */
+  size_t records_length;
+  cprogress_tracerecord_t records[];
+} cprogress_trace_t;
+
+
+/* export: snapshots of all slots for other programs, see cprogress_enableexport(...) */
+typedef enum {
+  CPROGRESS_EXPORT_JSONLINES = 1, /* a line per slot, appended */
+  CPROGRESS_EXPORT_PROMETHEUS, /* text exposition format, the file is replaced */
+} cprogress_export_type_t;
+
+/*
+  record: a compact log of slots to replay, see cprogress_enablerecord(...); all numbers are
+  LEB128 varints, signed ones zigzag encoded
+    header: CPROGRESS_RECORD_MAGIC, CPROGRESS_RECORD_STEPS, wall clock at start in ms,
+      formats attached so far: count, then per format its chunks: count, then per chunk
+      type, span_width + 1, is_autospan and literal_length + literal for a literal or
+      fill_char for a bar
+    frame, only when a slot changed: us since the previous frame, slots, 0
+    slot: thread_index - previous thread_index of the frame (starting at -1), fields, values
+      of the fields in the order of their bits
+  fields past CPROGRESS_RECORD_KNOWNFIELDS take one varint each, so that a reader skips those
+  it doesn't know
+*/
+#define CPROGRESS_RECORD_MAGIC "cprgrec2"
+
+typedef enum {
+  CPROGRESS_RECORD_START = 1 << 0, /* (re)started, all fields are back to zero */
+  CPROGRESS_RECORD_TITLE = 1 << 1, /* length, bytes */
+  CPROGRESS_RECORD_STEP = 1 << 2, /* percentage in 1 / CPROGRESS_RECORD_STEPS, signed delta; without total only */
+  CPROGRESS_RECORD_DONE = 1 << 3, /* signed delta */
+  CPROGRESS_RECORD_TOTAL = 1 << 4,
+  CPROGRESS_RECORD_INDETERMINATE = 1 << 5,
+  CPROGRESS_RECORD_PARENT = 1 << 6, /* parent thread_index + 1, weight */
+  CPROGRESS_RECORD_STOP = 1 << 7,
+  CPROGRESS_RECORD_FORMAT = 1 << 8, /* format_index, as in the header */
+
+  CPROGRESS_RECORD_KNOWNFIELDS = (1 << 9) - 1,
+} cprogress_record_field_t;
+
+typedef enum {
+  CPROGRESS_SLOTSTATE_IDLE, /* never started */
+  CPROGRESS_SLOTSTATE_RUNNING,
+  CPROGRESS_SLOTSTATE_FINISHED, /* stopped at 100% */
+  CPROGRESS_SLOTSTATE_ABORTED,
+} cprogress_slotstate_t;
+
+
+/* threadinfo */
+typedef struct cprogress_threadinfo {
+  /* persistent */
+  int is_valid; /* indicate if it's a EOF */
+  int thread_index;
+  cprogress_eventqueue_t *eventqueue;
+  cprogress_trace_t *trace; /* NULL unless tracing */
+
+  uint32_t freelist_next; /* next free thread_index + 1, see cprogress_release(...) */
+
+  /* hierarchy, see cprogress_attachthread(...), all atomic */
+  uint32_t parent; /* parent thread_index + 1, zero for a root */
+  struct cprogress_threadinfo *parent_threadinfo;
+  uint32_t weight; /* share in parent */
+  int is_collapsed;
+  int64_t rollup_value; /* progress in CPROGRESS_ROLLUP_SCALE as counted by parent */
+  int64_t rollup_accum; /* sum of weight * rollup_value of children */
+  uint64_t rollup_weight; /* sum of weight of children, non-zero makes it a parent */
+
+  uint64_t tick_count; /* liveness only, bumped by the updater without seqlock */
+
+  /* seqlock, odd while the updater is writing fields below */
+  uint32_t seq;
+
+  int is_running;
+  uint32_t start_count; /* increased every time the thread starts */
+  uint32_t stop_count; /* increased every time the thread stops */
+  char title[CPROGRESS_TITLE_MAXLEN];
+  float percentage;
+  uint64_t done;
+  uint64_t total;
+  int is_indeterminate;
+  uint32_t format_index; /* see cprogress_attachformat(...) */
+
+  /* internal, only touched by the renderer */
+  uint32_t rendered_stop_count;
+  uint32_t rendered_start_count;
+  uint64_t start_ns; /* frame time when the renderer first saw it running */
+  uint64_t stop_ns;
+  uint64_t update_ns; /* frame time when its progress last moved */
+  uint64_t sample_ns;
+  double sample_value;
+  double rate; /* smoothed, negative when unknown */
+  uint64_t rendered_tick_count;
+  uint32_t spinner_index;
+  uint32_t render_parent; /* thread_index + 1 as below, taken once per frame */
+  uint32_t render_firstchild;
+  uint32_t render_lastchild;
+  uint32_t render_nextsibling;
+  float traced_percentage; /* last one traced as CPROGRESS_TRACE_PROGRESS */
+  uint32_t exported_stop_count;
+  /* as taken by the exporter, for the metric families after the first one */
+  cprogress_slotstate_t export_state;
+  float export_percentage;
+  uint64_t export_done;
+  uint64_t export_total;
+  double export_rate;
+  int64_t export_elapsed_ns;
+  int64_t export_eta_ns;
+  /* as last recorded, see cprogress_enablerecord(...) */
+  uint32_t recorded_start_count;
+  int recorded_is_running;
+  uint32_t recorded_titlehash;
+  int32_t recorded_step;
+  uint64_t recorded_done;
+  uint64_t recorded_total;
+  int recorded_is_indeterminate;
+  uint32_t recorded_parent;
+  uint32_t recorded_format_index;
+} cprogress_threadinfo_t;
+
+/* a consistent copy of threadinfo taken by the renderer */
+typedef struct {
+  int thread_index;
+
+  int is_running;
+  int is_just_stopped;
+  uint32_t start_count;
+  uint32_t stop_count;
+  char title[CPROGRESS_TITLE_MAXLEN];
+  float percentage; /* rolled up for a parent */
+  uint64_t done;
+  uint64_t total;
+  int is_indeterminate;
+  uint32_t format_index;
+  uint64_t tick_count;
+
+  int is_parent;
+} cprogress_threadsnapshot_t;
+
+/* thread_index must be valid, i.e. from cprogress_create(...) or cprogress_acquire(...) */
+#define cprogress_getthreadinfo(cp, thread_index) (*cprogress_threadinfo_at(cp, thread_index))
+#define cprogress_getthreadinfos_length(cp) __atomic_load_n(&(cp)->threadinfos_length, __ATOMIC_ACQUIRE)
+#define cprogress_threadinfo_getindex(threadinfo) ((threadinfo)->thread_index)
+#define cprogress_threadinfo_foreach(cp, name) \
+  for (cprogress_threadinfo_t *name = cprogress_threadinfo_first(cp); name; name = cprogress_threadinfo_next(cp, name))
+
+
+/* lineinfo: everything a line may show */
+typedef struct {
+  const char *title;
+  float percentage;
+  uint64_t done;
+  uint64_t total; /* zero when only percentage is given */
+
+  double rate; /* per second, in done or in percentage when total is zero; negative when unknown */
+  int64_t elapsed_ns; /* negative when unknown */
+  int64_t eta_ns; /* negative when unknown */
+  int64_t idle_ns; /* since progress last moved, negative when unknown */
+
+  int is_indeterminate;
+  uint32_t spinner_index; /* animation step of spinner and bouncing bar */
+  uint32_t format_index; /* which format of the instance writes it */
+} cprogress_lineinfo_t;
+
+#define cprogress_lineinfo_make(title, percentage) \
+  ((cprogress_lineinfo_t) { (title), (percentage), 0, 0, CPROGRESS_UNDEF, CPROGRESS_UNDEF, CPROGRESS_UNDEF, CPROGRESS_UNDEF, 0, 0, 0 })
+
+
+/* frame: taken once at the beginning of cprogress_render(...), shared by the whole frame */
+typedef struct {
+  uint64_t now_ns; /* from CPROGRESS_FRAME_CLOCK */
+  uint64_t index; /* how many frames were rendered before */
+} cprogress_frame_t;
+
+
+/* local: thread-local accumulator, batches updates of one thread */
+typedef struct {
+  cprogress_threadinfo_t *threadinfo;
+
+  uint64_t done;
+  uint64_t total;
+  uint64_t flush_at; /* next [done] that needs publishing */
+  uint32_t clockcheck_countdown; /* calls left before reading the clock */
+
+  uint64_t published;
+  uint32_t flush_count;
+  uint64_t flush_ns;
+  uint64_t last_flush_ns;
+} cprogress_local_t;
+
+
+/* shared header: at the beginning of a named segment, tells a viewer where the slots are */
+#define CPROGRESS_SHARED_MAGIC 0x67727063u /* "cprg", stored last */
+#define CPROGRESS_SHAREDHEADER_SIZE 64 /* the arena follows, keeping its alignment */
+
+typedef struct {
+  uint32_t magic;
+  uint32_t threadinfo_size; /* sizeof(cprogress_threadinfo_t), differs with other settings */
+  uint64_t threadinfos_offset; /* of slot 0 from the beginning of the segment */
+  uint64_t threadinfos_length;
+  int64_t pid; /* of the process that created it */
+} cprogress_sharedheader_t;
+
+
+/* stats: what the renderer has cost so far, see cprogress_stats(...) */
+typedef struct {
+  uint64_t frames_rendered;
+  uint64_t frames_skipped; /* frame intervals that passed without a frame */
+  uint64_t deadlines_missed; /* frames that took longer than the frame interval */
+  uint64_t bytes_written;
+  uint64_t write_calls; /* write(2), one per frame unless the frame buffer fills up */
+  int console_width; /* last one read, zero before the first line */
+
+  uint64_t render_ns; /* of all frames */
+  uint64_t elapsed_ns; /* from the beginning of the first frame to the end of the last one */
+  uint64_t render_p50_ns;
+  uint64_t render_p90_ns;
+  uint64_t render_p99_ns;
+  uint64_t render_p999_ns;
+  uint64_t render_max_ns;
+} cprogress_stats_t;
 
 
 /* instance */
 typedef struct cprogress {
   cprogress_error_t error;
 
-  int has_autospan_element; /* deprecated */
+  cprogress_format_t *formats[CPROGRESS_FORMAT_MAXLEN]; /* retained, [0] is the one it was created with */
+  size_t formats_length;
+  uint32_t displaychunk_types; /* of all formats */
 
-  size_t displaychunks_length;
-  cprogress_displaychunk_t *displaychunks;
+  cprogress_allocator_t allocator; /* copied on creation, see cprogress_create_withallocator(...) */
+  int is_shared; /* by forked processes, see cprogress_create_shared(...) */
+  char shared_name[CPROGRESS_SHAREDNAME_MAXLEN]; /* empty unless from cprogress_create_named(...) */
+  void *arena; /* the only allocation besides grown segments */
+  size_t arena_size;
 
-  cprogress_stralloc_t stralloc;
+  int console_width;
+  int keep_consolewidth_loopcount;
+  char *frame_buf; /* output is gathered here and handed to write(2), in arena */
+  size_t frame_buf_len;
+  size_t frame_buf_used;
+  int is_inframe; /* lines wait for the end of the frame instead of being written right away */
 
   int is_running;
   int last_alive_thread_count;
-  size_t threadinfos_length;
-  cprogress_threadinfo_t *threadinfos;
-
-  cprogress_eventsubscriber_func_t *subscribers[CPROGRESS_EVENT_LENGTH];
+  int has_hierarchy; /* draw as a tree */
+  cprogress_frame_t frame;
+  uint64_t frame_interval_ns; /* zero when unknown, see cprogress_setframerate(...) */
+  cprogress_stats_t stats; /* counters only, percentiles come from the histogram */
+  uint64_t stats_firstframe_ns;
+  uint64_t stats_lastframe_ns;
+  uint32_t *stats_histogram; /* CPROGRESS_STATS_HISTOGRAM_LENGTH frame counts, in arena */
+  uint32_t render_firstroot;
+  /* segment 0 holds [0, 1 << shift), segment k > 0 holds [1 << (shift + k - 1), 1 << (shift + k)) */
+  size_t threadinfos_length; /* thread data in use are below this */
+  size_t threadinfos_reserved; /* next thread_index the pool hands out when freelist is empty */
+  size_t threadinfo_segmentshift;
+  cprogress_threadinfo_t *threadinfo_segments[CPROGRESS_THREADINFO_SEGMENT_MAXLEN];
+  uint64_t threadinfo_freelist; /* tag << 32 | (thread_index + 1), tag avoids ABA */
+
+  int is_finish_pushed;
+  cprogress_eventqueue_t *eventqueue;
+  cprogress_trace_t *trace; /* see cprogress_enabletrace(...) */
+  cprogress_export_type_t export_type; /* zero unless cprogress_enableexport(...) */
+  char export_path[CPROGRESS_EXPORTPATH_MAXLEN];
+  int export_fd; /* kept open for JSON Lines, the temporary file while writing Prometheus */
+  uint64_t export_interval_ns; /* zero when only by cprogress_writeexport(...) */
+  uint64_t export_lastns;
+  uint64_t export_index;
+  char *export_buf; /* CPROGRESS_EXPORTBUFFER_LENGTH bytes, allocated by cprogress_enableexport(...) */
+  size_t export_buf_used;
+  int record_fd;
+  char *record_buf; /* CPROGRESS_RECORDBUFFER_LENGTH bytes, NULL unless cprogress_enablerecord(...) */
+  size_t record_buf_used;
+  uint64_t record_lastns; /* frame time of the last frame written, moved in whole us */
+  uint64_t record_flushns;
+  size_t subscribers_length[CPROGRESS_EVENT_LENGTH];
+  cprogress_eventsubscriber_t subscribers[CPROGRESS_EVENT_LENGTH][CPROGRESS_SUBSCRIBER_MAXLEN];
+  size_t batchsubscribers_length;
+  cprogress_eventbatchsubscriber_t batchsubscribers[CPROGRESS_SUBSCRIBER_MAXLEN];
 } cprogress_t;
 
 
 
 /* instance */
 cprogress_t cprogress_create(const char *fmt, int thread_count);
+cprogress_t cprogress_create_withallocator(const char *fmt, int thread_count, const cprogress_allocator_t *allocator);
+cprogress_t cprogress_create_withchunks(const cprogress_displaychunk_t *displaychunks, int thread_count);
+cprogress_t cprogress_create_withformat(cprogress_format_t *format, int thread_count);
+cprogress_t cprogress_create_shared(const char *fmt, int thread_count);
+cprogress_t cprogress_create_named(const char *fmt, int thread_count, const char *name);
 void cprogress_destroy(cprogress_t *cprogress);
 
+/* allocator */
+void cprogress_setdefaultallocator(const cprogress_allocator_t *allocator);
+void *cprogress_allocator_alloc(const cprogress_allocator_t *allocator, size_t size, size_t align);
+void cprogress_allocator_free(const cprogress_allocator_t *allocator, void *ptr, size_t size);
+
+/* format */
+cprogress_format_t *cprogress_format_create(const char *fmt, cprogress_error_t *error);
+cprogress_format_t *cprogress_format_create_withallocator(const char *fmt, cprogress_error_t *error,
+  const cprogress_allocator_t *allocator);
+void cprogress_format_retain(cprogress_format_t *format);
+void cprogress_format_release(cprogress_format_t *format);
+int cprogress_attachformat(cprogress_t *cprogress, cprogress_format_t *format);
+
 /* object */
 
 
@@ -266,39 +1046,134 @@ void cprogress_threadinfo_start(cprogress_threadinfo_t *threadinfo);
 void cprogress_threadinfo_abort(cprogress_threadinfo_t *threadinfo);
 void cprogress_startthread(cprogress_t *cprogress, int thread_index);
 void cprogress_abortthread(cprogress_t *cprogress, int thread_index);
+void cprogress_threadinfo_recover(cprogress_threadinfo_t *threadinfo);
+void cprogress_recoverthread(cprogress_t *cprogress, int thread_index);
 
 void cprogress_startallthreads(cprogress_t *cprogress);
 
+/* task/thread hierarchy */
+int cprogress_attachthread(cprogress_t *cprogress, int thread_index, int parent_index, uint32_t weight);
+void cprogress_detachthread(cprogress_t *cprogress, int thread_index);
+void cprogress_collapsethread(cprogress_t *cprogress, int thread_index, int is_collapsed);
+
+/* task/thread pool */
+int cprogress_acquire(cprogress_t *cprogress);
+void cprogress_release(cprogress_t *cprogress, int thread_index);
+
+/* task/thread storage */
+size_t cprogress_threadinfo_segmentlength(const cprogress_t *cprogress, size_t segment);
+void cprogress_threadinfo_initsegment(cprogress_t *cprogress, cprogress_threadinfo_t *threadinfos, size_t segment);
+cprogress_threadinfo_t *cprogress_threadinfo_ensuresegment(cprogress_t *cprogress, size_t segment);
+cprogress_threadinfo_t *cprogress_threadinfo_at(cprogress_t *cprogress, size_t thread_index);
+cprogress_threadinfo_t *cprogress_threadinfo_first(cprogress_t *cprogress);
+cprogress_threadinfo_t *cprogress_threadinfo_next(cprogress_t *cprogress, cprogress_threadinfo_t *threadinfo);
+
+/* task/thread reader */
+void cprogress_threadinfo_snapshot(const cprogress_threadinfo_t *threadinfo, cprogress_threadsnapshot_t *snapshot);
+void cprogress_threadinfo_sample(cprogress_t *cprogress, cprogress_threadinfo_t *threadinfo,
+  const cprogress_threadsnapshot_t *snapshot, cprogress_lineinfo_t *lineinfo);
+
 /* view basic */
 size_t cprogress_writeliteral(char *buf, size_t buf_len, const char *literal, size_t alloc_width);
 size_t cprogress_writepercentage(char *buf, size_t buf_len, float percentage, size_t alloc_width);
 size_t cprogress_writeprogressbar(char *buf, size_t buf_len, char fill_char, float percentage);
-
-void cprogress_writeline(cprogress_t *cprogress, char *buf, size_t buf_len, size_t console_width, const char *title, float percentage);
+size_t cprogress_writebouncingbar(char *buf, size_t buf_len, char fill_char, uint32_t step);
+size_t cprogress_measurestring(const char *str);
+
+/* chunk texts, buf holds at least CPROGRESS_CHUNKSTRING_MAXLEN bytes */
+size_t cprogress_sprintpercentage(char *buf, float percentage);
+size_t cprogress_sprintcount(char *buf, uint64_t done, uint64_t total, int is_bytes);
+size_t cprogress_sprintduration(char *buf, int64_t ns);
+size_t cprogress_sprintrate(char *buf, double rate, int is_bytes, int is_percentage);
+size_t cprogress_sprintspinner(char *buf, uint32_t spinner_index);
+
+size_t cprogress_writeline(cprogress_t *cprogress, char *buf, size_t buf_len, size_t console_width, const char *title, float percentage);
+size_t cprogress_writelineinfo(cprogress_t *cprogress, char *buf, size_t buf_len, size_t console_width, const cprogress_lineinfo_t *lineinfo);
 void cprogress_printline(cprogress_t *cprogress, const char *title, float percentage);
+void cprogress_printlineinfo(cprogress_t *cprogress, const cprogress_lineinfo_t *lineinfo);
 
 /* view controller */
 void cprogress_abort(cprogress_t *cprogress);
 int cprogress_stillrunning(cprogress_t *cprogress);
 void cprogress_waitfps(int fps);
 void cprogress_render(cprogress_t *cprogress);
+void cprogress_renderat(cprogress_t *cprogress, uint64_t now_ns);
 void cprogress_rendersum(cprogress_t *cprogress, const char *title);
 
 /* view controller alternative: one line to show all till none left */
 void cprogress_render_tillcomplete(cprogress_t *cprogress, int fps);
 
+/* stats */
+void cprogress_setframerate(cprogress_t *cprogress, int fps);
+void cprogress_stats(const cprogress_t *cprogress, cprogress_stats_t *stats);
+
+/* trace */
+cprogress_error_t cprogress_enabletrace(cprogress_t *cprogress, size_t records_length);
+void cprogress_pushtrace(cprogress_trace_t *trace, cprogress_trace_type_t type, int thread_index, uint64_t ns,
+  float percentage, const char *title);
+cprogress_error_t cprogress_writetrace(const cprogress_t *cprogress, const char *path);
+cprogress_error_t cprogress_writetrace_fd(const cprogress_t *cprogress, int fd);
+
+/* export */
+cprogress_error_t cprogress_enableexport(cprogress_t *cprogress, cprogress_export_type_t type, const char *path, int interval_ms);
+cprogress_error_t cprogress_writeexport(cprogress_t *cprogress);
+
+/* record */
+cprogress_error_t cprogress_enablerecord(cprogress_t *cprogress, const char *path);
+cprogress_error_t cprogress_flushrecord(cprogress_t *cprogress);
+size_t cprogress_putvarint(char *buf, uint64_t value);
+int cprogress_getvarint(const char **cursor, const char *end, uint64_t *value);
+
 /* data provider */
 void cprogress_threadinfo_updatetitle(cprogress_threadinfo_t *threadinfo, const char *title);
 void cprogress_threadinfo_updatepercentage(cprogress_threadinfo_t *threadinfo, float percentage);
 void cprogress_updatethread_title(cprogress_t *cprogress, int thread_index, const char *title);
 void cprogress_updatethread_percentage(cprogress_t *cprogress, int thread_index, float percentage);
+void cprogress_threadinfo_updateprogress(cprogress_threadinfo_t *threadinfo, uint64_t done, uint64_t total);
+void cprogress_updatethread_progress(cprogress_t *cprogress, int thread_index, uint64_t done, uint64_t total);
+void cprogress_threadinfo_updateindeterminate(cprogress_threadinfo_t *threadinfo, int is_indeterminate);
+void cprogress_updatethread_indeterminate(cprogress_t *cprogress, int thread_index, int is_indeterminate);
+void cprogress_threadinfo_updateformat(cprogress_threadinfo_t *threadinfo, int format_index);
+void cprogress_updatethread_format(cprogress_t *cprogress, int thread_index, int format_index);
+
+/* liveness only, one thread at a time per thread_index as other updaters */
+static inline void cprogress_threadinfo_tick(cprogress_threadinfo_t *threadinfo) {
+  __atomic_store_n(&threadinfo->tick_count, __atomic_load_n(&threadinfo->tick_count, __ATOMIC_RELAXED) + 1, __ATOMIC_RELAXED);
+}
+
+#define cprogress_tickthread(cp, thread_index) cprogress_threadinfo_tick(cprogress_threadinfo_at(cp, thread_index))
+
+/* thread-local accumulator */
+cprogress_local_t cprogress_local_create(cprogress_t *cprogress, int thread_index, uint64_t total, uint32_t flush_count, uint64_t flush_ns);
+void cprogress_local_poll(cprogress_local_t *local);
+void cprogress_local_flush(cprogress_local_t *local);
+
+/* the hot path, kept inline so that one item costs an add and two compares */
+static inline void cprogress_local_add(cprogress_local_t *local, uint64_t count) {
+  if ((local->done += count) >= local->flush_at || !--local->clockcheck_countdown)
+    cprogress_local_poll(local);
+}
 
 /* event controller */
-void cprogress_subscribeevent(cprogress_t *cprogress, cprogress_event_type_t type, cprogress_eventsubscriber_func_t *func);
+int cprogress_subscribeevent(cprogress_t *cprogress, cprogress_event_type_t type, cprogress_eventsubscriber_func_t *func);
+int cprogress_subscribeevent_userdata(cprogress_t *cprogress, cprogress_event_type_t type, cprogress_eventlistener_func_t *listener, void *userdata);
+void cprogress_unsubscribeevent(cprogress_t *cprogress, cprogress_event_type_t type, cprogress_eventlistener_func_t *listener, void *userdata);
+int cprogress_subscribebatch(cprogress_t *cprogress, cprogress_eventbatch_func_t *func, void *userdata);
+void cprogress_unsubscribebatch(cprogress_t *cprogress, cprogress_eventbatch_func_t *func, void *userdata);
 void cprogress_emitevent(cprogress_t *cprogress, cprogress_event_type_t type, int thread_index);
+uint64_t cprogress_eventqueue_claim(cprogress_eventqueue_t *eventqueue);
+int cprogress_eventqueue_fill(cprogress_eventqueue_t *eventqueue, uint64_t pos, cprogress_event_type_t type, int thread_index);
+int cprogress_pushevent(cprogress_eventqueue_t *eventqueue, cprogress_event_type_t type, int thread_index);
+int cprogress_popevent(cprogress_eventqueue_t *eventqueue, cprogress_event_t *event);
+void cprogress_recoverevents(cprogress_eventqueue_t *eventqueue);
+void cprogress_dispatchevents(cprogress_t *cprogress);
 
 
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif /* !CPROGRESS_H */
 
 
@@ -309,20 +1184,66 @@ void cprogress_emitevent(cprogress_t *cprogress, cprogress_event_type_t type, in
 
 
 
+#include "errno.h"
+#include "fcntl.h"
+#include "signal.h"
+#include "stdarg.h"
 #include "stdio.h"
 #include "stdlib.h"
 #include "string.h"
 #include "time.h"
 
+#include "sched.h"
 #include "sys/ioctl.h"
+#include "sys/mman.h"
+#include "sys/stat.h"
 #include "unistd.h"
 
 #define CPROGRESS_CONSOLE_UPDATEWIDTH_LOOPCOUNT 10
-#define CPROGRESS_DISPLAYCHUNK_MAXLEN 16
+#define CPROGRESS_CONSOLE_FALLBACKWIDTH 80
+
+/* a display column takes up to 4 bytes in UTF-8 */
+#define _cprogress_printline_widthtolength(width) ((width) * 4 + 1)
+
+/* room cprogress_printlineinfo(...) takes in the frame buffer */
+#define CPROGRESS_PRINTLINE_MAXLEN _cprogress_printline_widthtolength(CPROGRESS_CONSOLE_MAXWIDTH)
+
+/* what cprogress_render(...) reads once per frame, CLOCK_MONOTONIC_COARSE is cheaper but
+   only ticks every few milliseconds */
+#ifndef CPROGRESS_FRAME_CLOCK
+#define CPROGRESS_FRAME_CLOCK CLOCK_MONOTONIC
+#endif
+
+/* how many cprogress_local_add(...) calls pass between two clock reads */
+#ifndef CPROGRESS_LOCAL_CLOCKCHECK_INTERVAL
+#define CPROGRESS_LOCAL_CLOCKCHECK_INTERVAL 64
+#endif
+
+/* how long a snapshot waits for a write to finish before taking the fields as they are, the
+   updater may be preempted or, with cprogress_create_shared(...), gone with its process */
+#ifndef CPROGRESS_SNAPSHOT_MAXRETRY
+#define CPROGRESS_SNAPSHOT_MAXRETRY 1024
+#endif
+#define CPROGRESS_SNAPSHOT_SPINRETRY 64 /* then it yields */
+
+/* USDT probes of provider "cprogress", only with CPROGRESS_USDT; each is a nop until traced */
+#ifdef CPROGRESS_USDT
+#include "sys/sdt.h"
+#define cprogress_probe2(name, a, b) DTRACE_PROBE2(cprogress, name, a, b)
+#define cprogress_probe3(name, a, b, c) DTRACE_PROBE3(cprogress, name, a, b, c)
+#define cprogress_probe4(name, a, b, c, d) DTRACE_PROBE4(cprogress, name, a, b, c, d)
+#else
+#define cprogress_probe2(name, a, b)
+#define cprogress_probe3(name, a, b, c)
+#define cprogress_probe4(name, a, b, c, d)
+#endif
+
+/* percentage as probes pass it, integers only */
+#define _cprogress_probe_percentage(percentage) ((int64_t) ((percentage) * (CPROGRESS_ROLLUP_SCALE / 100)))
 
 
 /*----------------------------------------------------------------------------
-| utils & stralloc
+| utils
 ----------------------------------------------------------------------------*/
 
 void cprogress_msleep(long ms) {
@@ -333,46 +1254,283 @@ void cprogress_msleep(long ms) {
   nanosleep(&ts, NULL);
 }
 
-char *cprogress_strdup(const char *str) {
-  if (str) {
-    char * newstr = (char *) malloc(strlen(str));
-    strcpy(newstr, str);
-    return newstr;
+#if defined(__x86_64__) || defined(__i386__)
+#define cprogress_cpurelax() __builtin_ia32_pause()
+#else
+#define cprogress_cpurelax()
+#endif
+
+uint64_t cprogress_getnanotime() {
+  struct timespec ts;
+  clock_gettime(CPROGRESS_FRAME_CLOCK, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* coarse clock is read from vDSO without a syscall, good enough for flush thresholds */
+uint64_t cprogress_getcoarsenanotime() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*----------------------------------------------------------------------------
+| allocator
+----------------------------------------------------------------------------*/
+
+#ifdef CPROGRESS_STATIC_STORAGE
+
+/* bump allocation over the storage given by the program, nothing is ever given back */
+size_t cprogress_staticstorage_top = 0;
+
+void *cprogress_staticstorage_alloc(size_t size, size_t align, void *userdata) {
+  (void) userdata;
+  uintptr_t base = (uintptr_t) (CPROGRESS_STATIC_STORAGE);
+  size_t top = __atomic_load_n(&cprogress_staticstorage_top, __ATOMIC_RELAXED);
+  size_t offset;
+  do {
+    offset = ((base + top + align - 1) & ~(uintptr_t) (align - 1)) - base;
+    if (offset + size > (CPROGRESS_STATIC_STORAGE_LENGTH)) return NULL;
+  } while (!__atomic_compare_exchange_n(&cprogress_staticstorage_top, &top, offset + size,
+    1, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+  return (char *) base + offset;
+}
+
+void cprogress_staticstorage_free(void *ptr, size_t size, void *userdata) {
+  (void) ptr; (void) size; (void) userdata;
+}
+
+cprogress_allocator_t cprogress_defaultallocator = { cprogress_staticstorage_alloc, cprogress_staticstorage_free, NULL };
+
+#else
+
+void *cprogress_heap_alloc(size_t size, size_t align, void *userdata) {
+  (void) userdata;
+  /* aligned_alloc(...) wants a multiple of the alignment */
+  return aligned_alloc(align, (size + align - 1) & ~(align - 1));
+}
+
+void cprogress_heap_free(void *ptr, size_t size, void *userdata) {
+  (void) size; (void) userdata;
+  free(ptr);
+}
+
+cprogress_allocator_t cprogress_defaultallocator = { cprogress_heap_alloc, cprogress_heap_free, NULL };
+
+#endif
+
+/* shared: anonymous shared mapping, forked processes see the same memory at the same address */
+void *cprogress_shared_alloc(size_t size, size_t align, void *userdata) {
+  (void) align; (void) userdata; /* page aligned */
+  void *ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  return ptr == MAP_FAILED? NULL: ptr;
+}
+
+void cprogress_shared_free(void *ptr, size_t size, void *userdata) {
+  (void) userdata;
+  munmap(ptr, size);
+}
+
+const cprogress_allocator_t cprogress_sharedallocator = { cprogress_shared_alloc, cprogress_shared_free, NULL };
+
+/* named: shm_open(3) segment of [userdata] as name, a header ahead of what is returned */
+int cprogress_named_isalive(int64_t pid) {
+  return pid > 0 && (!kill(pid, 0) || errno == EPERM);
+}
+
+/*
+  a segment under the name of a process still alive is left alone, EEXIST; one left behind by
+  a crashed run is unlinked and made again, never cut while somebody may have it mapped
+*/
+void *cprogress_named_alloc(size_t size, size_t align, void *userdata) {
+  (void) align; /* page aligned, the header keeps CPROGRESS_ARENA_ALIGN */
+  const char *name = (const char *) userdata;
+  int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+  if (fd < 0 && errno == EEXIST) {
+    int old_fd = shm_open(name, O_RDONLY, 0);
+    if (old_fd < 0) return NULL;
+
+    /* the owner writes its pid first thing, without one it is still being set up */
+    struct stat st;
+    int64_t pid = 0;
+    if (!fstat(old_fd, &st) && st.st_size >= sizeof(cprogress_sharedheader_t)) {
+      void *old_segment = mmap(NULL, sizeof(cprogress_sharedheader_t), PROT_READ, MAP_SHARED, old_fd, 0);
+      if (old_segment != MAP_FAILED) {
+        pid = __atomic_load_n(&((cprogress_sharedheader_t *) old_segment)->pid, __ATOMIC_ACQUIRE);
+        munmap(old_segment, sizeof(cprogress_sharedheader_t));
+      }
+    }
+    close(old_fd);
+    if (!pid || cprogress_named_isalive(pid)) {
+      errno = EEXIST;
+      return NULL;
+    }
+
+    shm_unlink(name);
+    fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
   }
-  return NULL;
+  if (fd < 0) return NULL;
+
+  size_t segment_size = CPROGRESS_SHAREDHEADER_SIZE + size;
+  void *segment = ftruncate(fd, segment_size)? MAP_FAILED:
+    mmap(NULL, segment_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (segment == MAP_FAILED) {
+    shm_unlink(name);
+    return NULL;
+  }
+  __atomic_store_n(&((cprogress_sharedheader_t *) segment)->pid, (int64_t) getpid(), __ATOMIC_RELEASE);
+  return (char *) segment + CPROGRESS_SHAREDHEADER_SIZE;
 }
 
-cprogress_stralloc_t cprogress_stralloc_create(size_t size) {
-  char *buffer = (char *) malloc(size);
-  cprogress_stralloc_t stralloc = {
-    .buffer = buffer,
-    .length = 0,
-    .size = buffer? size: 0
-  };
-  return stralloc;
+/* the name is only unlinked while it is still ours, it may have been taken over since */
+void cprogress_named_free(void *ptr, size_t size, void *userdata) {
+  cprogress_sharedheader_t *header = (cprogress_sharedheader_t *) ((char *) ptr - CPROGRESS_SHAREDHEADER_SIZE);
+  int is_owned = header->pid == getpid();
+  munmap(header, CPROGRESS_SHAREDHEADER_SIZE + size);
+  if (is_owned) shm_unlink((const char *) userdata);
 }
 
-char *cprogress_stralloc_alloc(cprogress_stralloc_t *stralloc, const char *str, size_t len) {
-  if (!stralloc || !stralloc->buffer) return NULL;
+/* fallback taken by instances and formats created afterwards without one, NULL restores the built-in one */
+void cprogress_setdefaultallocator(const cprogress_allocator_t *allocator) {
+#ifdef CPROGRESS_STATIC_STORAGE
+  static const cprogress_allocator_t builtin = { cprogress_staticstorage_alloc, cprogress_staticstorage_free, NULL };
+#else
+  static const cprogress_allocator_t builtin = { cprogress_heap_alloc, cprogress_heap_free, NULL };
+#endif
+  cprogress_defaultallocator = allocator? *allocator: builtin;
+}
 
-  size_t actual_length = len + 1;
-  if (stralloc->length + actual_length >= stralloc->size) return NULL;
+/* zeroed, align is a power of 2 */
+void *cprogress_allocator_alloc(const cprogress_allocator_t *allocator, size_t size, size_t align) {
+  void *ptr = allocator->alloc(size, align, allocator->userdata);
+  if (ptr) memset(ptr, 0, size);
+  return ptr;
+}
 
-  char *dest = stralloc->buffer + stralloc->length;
-  strncpy(dest, str, len);
-  stralloc->length += actual_length;
-  return dest;
+void cprogress_allocator_free(const cprogress_allocator_t *allocator, void *ptr, size_t size) {
+  if (ptr) allocator->free(ptr, size, allocator->userdata);
+}
+
+
+/*----------------------------------------------------------------------------
+| eventqueue
+----------------------------------------------------------------------------*/
+
+/* cells_length must be a power of 2 */
+/* eventqueue points to sizeof(cprogress_eventqueue_t) + cells_length * sizeof(cprogress_eventcell_t) bytes */
+void cprogress_eventqueue_init(cprogress_eventqueue_t *eventqueue, size_t cells_length) {
+  eventqueue->head = 0;
+  eventqueue->tail = 0;
+  eventqueue->dropped_count = 0;
+  eventqueue->recovered_head = 0;
+  eventqueue->stalled_count = 0;
+  eventqueue->cells_length = cells_length;
+  for (size_t i = 0; i < cells_length; ++i) {
+    eventqueue->cells[i].seq = i;
+  }
 }
 
-void cprogress_stralloc_destroy(cprogress_stralloc_t *stralloc) {
-  if (stralloc) {
-    if (stralloc->buffer) {
-      free(stralloc->buffer);
-      stralloc->buffer = NULL;
+/* a position to push at, or CPROGRESS_EVENTCELL_WRITING when the queue is full */
+uint64_t cprogress_eventqueue_claim(cprogress_eventqueue_t *eventqueue) {
+  size_t mask = eventqueue->cells_length - 1;
+  uint64_t pos = __atomic_load_n(&eventqueue->head, __ATOMIC_RELAXED);
+  while (1) {
+    cprogress_eventcell_t *cell = &eventqueue->cells[pos & mask];
+    uint64_t seq = __atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE);
+    int64_t diff = (int64_t) (seq - pos);
+    if (diff == 0) {
+      /* the cell is free at this position, try to claim it; pos is refreshed on failure */
+      if (__atomic_compare_exchange_n(&eventqueue->head, &pos, pos + 1, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        return pos;
+    } else if (diff < 0) {
+      /* the dispatcher hasn't consumed this cell since the last lap, or it's still written */
+      return CPROGRESS_EVENTCELL_WRITING;
+    } else {
+      pos = __atomic_load_n(&eventqueue->head, __ATOMIC_RELAXED);
     }
   }
 }
 
+/*
+  the cell of a claimed position is taken before the event is written into it: when the
+  dispatcher has skipped the position meanwhile, the event is dropped and the cell, maybe
+  reused by a later lap, is left alone; non-zero then
+*/
+int cprogress_eventqueue_fill(cprogress_eventqueue_t *eventqueue, uint64_t pos, cprogress_event_type_t type, int thread_index) {
+  cprogress_eventcell_t *cell = &eventqueue->cells[pos & (eventqueue->cells_length - 1)];
+  uint64_t expected = pos;
+  if (!__atomic_compare_exchange_n(&cell->seq, &expected, pos | CPROGRESS_EVENTCELL_WRITING,
+    0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) return 1;
+
+  __atomic_store_n(&cell->event.type, type, __ATOMIC_RELAXED);
+  __atomic_store_n(&cell->event.thread_index, thread_index, __ATOMIC_RELAXED);
+  __atomic_store_n(&cell->seq, pos + 1, __ATOMIC_RELEASE);
+  return 0;
+}
+
+/* returns non-zero when the queue is full and the event is dropped, never blocks */
+int cprogress_pushevent(cprogress_eventqueue_t *eventqueue, cprogress_event_type_t type, int thread_index) {
+  if (!eventqueue) return 1;
+
+  uint64_t pos = cprogress_eventqueue_claim(eventqueue);
+  int is_dropped;
+  if (pos == CPROGRESS_EVENTCELL_WRITING) {
+    __atomic_fetch_add(&eventqueue->dropped_count, 1, __ATOMIC_RELAXED);
+    is_dropped = 1;
+  } else {
+    /* a skipped position is counted by the dispatcher */
+    is_dropped = cprogress_eventqueue_fill(eventqueue, pos, type, thread_index);
+  }
+  cprogress_probe3(event_push, type, thread_index, is_dropped);
+  return is_dropped;
+}
+
+/* only one thread may pop; returns zero when there's nothing ready */
+int cprogress_popevent(cprogress_eventqueue_t *eventqueue, cprogress_event_t *event) {
+  if (!eventqueue || !event) return 0;
+
+  uint64_t pos = eventqueue->tail;
+  cprogress_eventcell_t *cell = &eventqueue->cells[pos & (eventqueue->cells_length - 1)];
+  /* an updater that claimed this position but hasn't finished writing also holds back later
+    events, which keeps the order */
+  uint64_t seq = __atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE);
+  if (seq != pos + 1) {
+    /* claimed but the cell never taken, e.g. a forked worker that died right in between: a
+      position claimed before a worker was recovered that stays so long enough is skipped as
+      dropped, moving seq on so that the updater, if it only was slow, can't take the cell */
+    if (seq != pos || __atomic_load_n(&eventqueue->head, __ATOMIC_RELAXED) == pos) return 0;
+    if (++eventqueue->stalled_count < CPROGRESS_EVENTQUEUE_MAXSTALL ||
+      pos >= __atomic_load_n(&eventqueue->recovered_head, __ATOMIC_RELAXED)) return 0;
+    uint64_t expected = pos;
+    if (!__atomic_compare_exchange_n(&cell->seq, &expected, pos + eventqueue->cells_length, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+      return 0; /* taken just now, popped once written */
+    __atomic_fetch_add(&eventqueue->dropped_count, 1, __ATOMIC_RELAXED);
+    eventqueue->stalled_count = 0;
+    eventqueue->tail = pos + 1;
+    return cprogress_popevent(eventqueue, event);
+  }
+
+  event->type = __atomic_load_n(&cell->event.type, __ATOMIC_RELAXED);
+  event->thread_index = __atomic_load_n(&cell->event.thread_index, __ATOMIC_RELAXED);
+  __atomic_store_n(&cell->seq, pos + eventqueue->cells_length, __ATOMIC_RELEASE);
+  eventqueue->stalled_count = 0;
+  eventqueue->tail = pos + 1;
+  return 1;
+}
+
+/*
+  a worker known to be gone may have died inside cprogress_pushevent(...), holding a cell it
+  will never write; it can only be one claimed so far, the dispatcher may skip those
+*/
+void cprogress_recoverevents(cprogress_eventqueue_t *eventqueue) {
+  if (!eventqueue) return;
+
+  uint64_t head = __atomic_load_n(&eventqueue->head, __ATOMIC_RELAXED);
+  uint64_t recovered_head = __atomic_load_n(&eventqueue->recovered_head, __ATOMIC_RELAXED);
+  while (recovered_head < head && !__atomic_compare_exchange_n(&eventqueue->recovered_head,
+    &recovered_head, head, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+
 
 /*----------------------------------------------------------------------------
 | instance
@@ -402,7 +1560,7 @@ typedef struct {
 #define cprogress_isfmtbegin(ch) (ch == '$')
 #define cprogress_ismarkautospan(ch) (ch == '=')
 #define cprogress_isnumber(ch) ((ch) >= '0' && (ch) <= '9')
-#define cprogress_isliteral(ch) ((ch) >= 'a' && (ch) <= 'z' || (ch) >= 'A' && (ch) <= 'Z')
+#define cprogress_isliteral(ch) (((ch) >= 'a' && (ch) <= 'z') || ((ch) >= 'A' && (ch) <= 'Z'))
 
 cprogress_token_type_t cprogress_findchartokentype(char ch) {
   if (cprogress_isfmtbegin(ch)) {
@@ -461,30 +1619,30 @@ cprogress_token_t cprogress_peektoken(const char *str) {
 }
 
 
-int cprogress_pushchunk(cprogress_t *cprogress, cprogress_displaychunk_t displaychunk) {
-  if (cprogress->displaychunks_length >= CPROGRESS_DISPLAYCHUNK_MAXLEN - 1) return 1;
-  cprogress->displaychunks[cprogress->displaychunks_length++] = displaychunk;
-  return 0;
+/* without displaychunks, i.e. the counting pass, chunks are only counted */
+void cprogress_pushchunk(cprogress_format_t *format, cprogress_displaychunk_t displaychunk) {
+  if (format->displaychunks) format->displaychunks[format->displaychunks_length] = displaychunk;
+  ++format->displaychunks_length;
+  format->displaychunk_types |= 1u << displaychunk.type;
 }
 
-
-#define _cprogress_create_returnerror(e) { cprogress_destroy(&cprogress); return (cprogress_t) { .error = e }; }
-cprogress_t cprogress_create(const char *fmt, int thread_count) {
-  cprogress_t cprogress = {
-    .displaychunks = (cprogress_displaychunk_t *) malloc(CPROGRESS_DISPLAYCHUNK_MAXLEN * sizeof(cprogress_displaychunk_t)),
-    .stralloc = cprogress_stralloc_create(strlen(fmt)),
-    .is_running = 1,
-    .threadinfos_length = thread_count,
-    .threadinfos = (cprogress_threadinfo_t *) malloc((thread_count + 1) * sizeof(cprogress_threadinfo_t))
-  };
-
-  if (!cprogress.displaychunks || !cprogress.stralloc.buffer || !cprogress.threadinfos)
-    _cprogress_create_returnerror(CPROGRESS_ERROR_INTERNAL);
-
-  for (int i = 0; i < cprogress.threadinfos_length; ++i) {
-    cprogress.threadinfos[i] = (cprogress_threadinfo_t) { .is_valid = 1, .thread_index = i };
+/* zero terminated, NULL in the counting pass */
+const char *cprogress_pushliteral(cprogress_format_t *format, const char *literal, size_t literal_length) {
+  char *dest = format->literals? format->literals + format->literals_length: NULL;
+  if (dest) {
+    memcpy(dest, literal, literal_length);
+    dest[literal_length] = 0;
   }
-  cprogress.threadinfos[cprogress.threadinfos_length] = (cprogress_threadinfo_t) { .is_valid = 0 };
+  format->literals_length += literal_length + 1;
+  return dest;
+}
+
+/* run twice by cprogress_create(...) and cprogress_format_create(...), first to count, then to fill */
+cprogress_error_t cprogress_parseformat(cprogress_format_t *format, const char *fmt) {
+  format->displaychunks_length = 0;
+  format->literals_length = 0;
+  format->has_autospan_element = 0;
+  format->displaychunk_types = 0;
 
   const char *literal = NULL;
   size_t literal_length = 0;
@@ -494,15 +1652,14 @@ cprogress_t cprogress_create(const char *fmt, int thread_count) {
     if (cprogress_isfmtbegin(*chptr) && !cprogress_isfmtbegin(last_ch)) {
       /* save previous literal if present */
       if (literal && literal_length) {
-        literal = cprogress_stralloc_alloc(&cprogress.stralloc, literal, literal_length);
+        literal = cprogress_pushliteral(format, literal, literal_length);
         cprogress_displaychunk_t displaychunk = {
           .type = CPROGRESS_DISPLAYCHUNK_LITERAL,
           .literal = literal,
           .literal_length = literal_length,
           .span_width = CPROGRESS_UNDEF
         };
-        if (cprogress_pushchunk(&cprogress, displaychunk))
-          _cprogress_create_returnerror(CPROGRESS_ERROR_BUFFUL);
+        cprogress_pushchunk(format, displaychunk);
 
         /* reinit literal vars */
         literal = NULL;
@@ -521,14 +1678,14 @@ cprogress_t cprogress_create(const char *fmt, int thread_count) {
         if (token.type == CPROGRESS_TOKEN_MARKAUTOSPAN) {
           displaychunk.is_autospan = 1;
           /* only accept one element that is auto spanned */
-          if (cprogress.has_autospan_element) _cprogress_create_returnerror(CPROGRESS_ERROR_INVAL);
-          cprogress.has_autospan_element = 1;
+          if (format->has_autospan_element) return CPROGRESS_ERROR_INVAL;
+          format->has_autospan_element = 1;
         } else if (token.type == CPROGRESS_TOKEN_NUMBER) {
           displaychunk.span_width = token.number;
         } else if (token.type == CPROGRESS_TOKEN_LITERAL_CHAR) {
           fmt_name = token.ch;
         } else {
-          _cprogress_create_returnerror(CPROGRESS_ERROR_INVAL);
+          return CPROGRESS_ERROR_INVAL;
         }
 
         chptr += token.read_length;
@@ -536,13 +1693,7 @@ cprogress_t cprogress_create(const char *fmt, int thread_count) {
 
       /* format should either be spanned or at fixed length */
       if (displaychunk.span_width != CPROGRESS_UNDEF && displaychunk.is_autospan) {
-        _cprogress_create_returnerror(CPROGRESS_ERROR_INVAL);
-      }
-
-      /* progress bar must has a specific length */
-      if (displaychunk.type == CPROGRESS_DISPLAYCHUNK_BAR &&
-        displaychunk.span_width == CPROGRESS_UNDEF && !displaychunk.is_autospan) {
-        _cprogress_create_returnerror(CPROGRESS_ERROR_INVAL);
+        return CPROGRESS_ERROR_INVAL;
       }
 
       /* such weird, we need to move back to current formst mark
@@ -553,7 +1704,7 @@ cprogress_t cprogress_create(const char *fmt, int thread_count) {
       char peeked_next_char = *(chptr + 1);
       switch (fmt_name) {
         default:
-          _cprogress_create_returnerror(CPROGRESS_ERROR_INVAL);
+          return CPROGRESS_ERROR_INVAL;
         /* title, $[number]t */
         case 't':
           displaychunk.type = CPROGRESS_DISPLAYCHUNK_TITLE;
@@ -565,17 +1716,49 @@ cprogress_t cprogress_create(const char *fmt, int thread_count) {
             displaychunk.fill_char = peeked_next_char;
             ++chptr;
           } else {
-            _cprogress_create_returnerror(CPROGRESS_ERROR_INVAL);
+            return CPROGRESS_ERROR_INVAL;
           }
           break;
         /* progress percent, $[number]p */
         case 'p':
           displaychunk.type = CPROGRESS_DISPLAYCHUNK_PERCENTAGE;
           break;
+        /* rate, $[number]r or $[number]R in bytes */
+        case 'r':
+          displaychunk.type = CPROGRESS_DISPLAYCHUNK_RATE;
+          break;
+        case 'R':
+          displaychunk.type = CPROGRESS_DISPLAYCHUNK_BYTERATE;
+          break;
+        /* time left, $[number]e */
+        case 'e':
+          displaychunk.type = CPROGRESS_DISPLAYCHUNK_ETA;
+          break;
+        /* time elapsed, $[number]T */
+        case 'T':
+          displaychunk.type = CPROGRESS_DISPLAYCHUNK_ELAPSED;
+          break;
+        /* spinner, $[number]s */
+        case 's':
+          displaychunk.type = CPROGRESS_DISPLAYCHUNK_SPINNER;
+          break;
+        /* done/total, $[number]c in counts or $[number]B in bytes */
+        case 'c':
+          displaychunk.type = CPROGRESS_DISPLAYCHUNK_COUNT;
+          break;
+        case 'B':
+          displaychunk.type = CPROGRESS_DISPLAYCHUNK_BYTES;
+          break;
+      }
+
+      /* progress bar must has a specific length */
+      if (displaychunk.type == CPROGRESS_DISPLAYCHUNK_BAR &&
+        displaychunk.span_width == CPROGRESS_UNDEF && !displaychunk.is_autospan) {
+        return CPROGRESS_ERROR_INVAL;
       }
 
       /* we are ready to push the chunk */
-      if (cprogress_pushchunk(&cprogress, displaychunk)) _cprogress_create_returnerror(CPROGRESS_ERROR_BUFFUL);
+      cprogress_pushchunk(format, displaychunk);
     } else {
       // TODO remove double $ */
       if (!literal) literal = chptr;
@@ -588,35 +1771,578 @@ cprogress_t cprogress_create(const char *fmt, int thread_count) {
 
   /* deal with tailing literal */
   if (literal_length) {
-    literal = cprogress_stralloc_alloc(&cprogress.stralloc, literal, literal_length);
+    literal = cprogress_pushliteral(format, literal, literal_length);
     cprogress_displaychunk_t displaychunk = {
       .type = CPROGRESS_DISPLAYCHUNK_LITERAL,
       .literal = literal,
       .literal_length = literal_length,
       .span_width = CPROGRESS_UNDEF
     };
-    if (cprogress_pushchunk(&cprogress, displaychunk)) _cprogress_create_returnerror(CPROGRESS_ERROR_BUFFUL);
+    cprogress_pushchunk(format, displaychunk);
+  }
+
+  cprogress_pushchunk(format, (cprogress_displaychunk_t) { .type = CPROGRESS_DISPLAYCHUNK_UNKNOWN });
+  if (format->displaychunks_length > CPROGRESS_DISPLAYCHUNK_MAXLEN + 1) return CPROGRESS_ERROR_INVAL;
+
+  return CPROGRESS_ERROR_OK;
+}
+
+
+/*
+  everything lives in one allocation, carved in this order:
+    event queue, the first segment of thread data, the format, its displaychunks and literals,
+    the line buffer of cprogress_printlineinfo(...)
+  segments grown later by the pool are allocated on their own.
+*/
+#define CPROGRESS_ARENA_ALIGN 64
+
+size_t cprogress_arena_carve(size_t *arena_size, size_t size, size_t align) {
+  size_t offset = (*arena_size + align - 1) & ~(align - 1);
+  *arena_size = offset + size;
+  return offset;
+}
+
+
+/* fills the lengths and types of a ready-made table, with the same rules as the parser */
+cprogress_error_t cprogress_format_inspect(cprogress_format_t *format) {
+  format->displaychunks_length = 0;
+  format->has_autospan_element = 0;
+  format->displaychunk_types = 0;
+
+  cprogress_format_displaychunk_foreach(format, displaychunk) {
+    if (displaychunk->type >= CPROGRESS_DISPLAYCHUNK_TYPE_LENGTH) return CPROGRESS_ERROR_INVAL;
+    if (displaychunk->is_autospan && (format->has_autospan_element || displaychunk->span_width != CPROGRESS_UNDEF))
+      return CPROGRESS_ERROR_INVAL;
+    if (displaychunk->type == CPROGRESS_DISPLAYCHUNK_BAR &&
+      displaychunk->span_width == CPROGRESS_UNDEF && !displaychunk->is_autospan)
+      return CPROGRESS_ERROR_INVAL;
+    if (format->displaychunks_length >= CPROGRESS_DISPLAYCHUNK_MAXLEN) return CPROGRESS_ERROR_INVAL;
+
+    ++format->displaychunks_length;
+    format->has_autospan_element |= displaychunk->is_autospan;
+    format->displaychunk_types |= 1u << displaychunk->type;
+  }
+  /* the terminating chunk counts, as in cprogress_pushchunk(...) */
+  ++format->displaychunks_length;
+  format->displaychunk_types |= 1u << CPROGRESS_DISPLAYCHUNK_UNKNOWN;
+
+  return CPROGRESS_ERROR_OK;
+}
+
+#define _cprogress_create_returnerror(e) { cprogress_destroy(&cprogress); return (cprogress_t) { .error = e }; }
+
+/*
+  everything but parsing the format, with [has_format] formats[0] is carved in the arena,
+  with room for [displaychunks_length] chunks and [literals_length] bytes of literals
+*/
+cprogress_t cprogress_create_base(const cprogress_allocator_t *allocator, int thread_count,
+  int has_format, size_t displaychunks_length, size_t literals_length) {
+  if (thread_count < 0) return (cprogress_t) { .error = CPROGRESS_ERROR_INVAL };
+
+  size_t segmentshift = 0;
+  while (((size_t) 1 << segmentshift) < CPROGRESS_THREADINFO_SEGMENT_MINLEN ||
+    ((size_t) 1 << segmentshift) < thread_count) ++segmentshift;
+
+  cprogress_t cprogress = {
+    .is_running = 1,
+    .allocator = *allocator,
+    .threadinfos_length = thread_count,
+    .threadinfos_reserved = thread_count,
+    .threadinfo_segmentshift = segmentshift
+  };
+
+  size_t arena_size = 0;
+  size_t eventqueue_offset = cprogress_arena_carve(&arena_size,
+    sizeof(cprogress_eventqueue_t) + CPROGRESS_EVENTQUEUE_LENGTH * sizeof(cprogress_eventcell_t), CPROGRESS_ARENA_ALIGN);
+  size_t threadinfos_offset = cprogress_arena_carve(&arena_size,
+    cprogress_threadinfo_segmentlength(&cprogress, 0) * sizeof(cprogress_threadinfo_t), CPROGRESS_ARENA_ALIGN);
+  size_t format_offset = cprogress_arena_carve(&arena_size, has_format? sizeof(cprogress_format_t): 0, sizeof(void *));
+  size_t displaychunks_offset = cprogress_arena_carve(&arena_size,
+    displaychunks_length * sizeof(cprogress_displaychunk_t), sizeof(void *));
+  size_t literals_offset = cprogress_arena_carve(&arena_size, literals_length, 1);
+  size_t frame_buf_len = CPROGRESS_FRAMEBUFFER_LENGTH > CPROGRESS_PRINTLINE_MAXLEN?
+    CPROGRESS_FRAMEBUFFER_LENGTH: CPROGRESS_PRINTLINE_MAXLEN;
+  size_t frame_buf_offset = cprogress_arena_carve(&arena_size, frame_buf_len, 1);
+  size_t histogram_offset = cprogress_arena_carve(&arena_size,
+    CPROGRESS_STATS_HISTOGRAM_LENGTH * sizeof(uint32_t), sizeof(uint32_t));
+
+  char *arena = (char *) cprogress_allocator_alloc(&cprogress.allocator, arena_size, CPROGRESS_ARENA_ALIGN);
+  if (!arena) return (cprogress_t) { .error = CPROGRESS_ERROR_INTERNAL };
+
+  cprogress.arena = arena;
+  cprogress.arena_size = arena_size;
+  cprogress.frame_buf = arena + frame_buf_offset;
+  cprogress.frame_buf_len = frame_buf_len;
+  cprogress.stats_histogram = (uint32_t *) (arena + histogram_offset);
+  cprogress.eventqueue = (cprogress_eventqueue_t *) (arena + eventqueue_offset);
+  cprogress_eventqueue_init(cprogress.eventqueue, CPROGRESS_EVENTQUEUE_LENGTH);
+  cprogress.threadinfo_segments[0] = (cprogress_threadinfo_t *) (arena + threadinfos_offset);
+  cprogress_threadinfo_initsegment(&cprogress, cprogress.threadinfo_segments[0], 0);
+  if (has_format) {
+    /* never freed on its own, it goes with the arena */
+    cprogress_format_t *format = (cprogress_format_t *) (arena + format_offset);
+    format->refcount = 1;
+    format->is_pinned = 1;
+    if (displaychunks_length) format->displaychunks = (cprogress_displaychunk_t *) (arena + displaychunks_offset);
+    if (literals_length) format->literals = arena + literals_offset;
+    cprogress.formats[0] = format;
+    cprogress.formats_length = 1;
   }
 
-  if (cprogress_pushchunk(&cprogress, (cprogress_displaychunk_t) { .type = CPROGRESS_DISPLAYCHUNK_UNKNOWN }))
-    _cprogress_create_returnerror(CPROGRESS_ERROR_BUFFUL);
+  return cprogress;
+}
+
+/* takes a table made elsewhere, e.g. by cprogress.hpp at compile time, it must outlive the instance */
+cprogress_t cprogress_create_withchunks(const cprogress_displaychunk_t *displaychunks, int thread_count) {
+  if (!displaychunks) return (cprogress_t) { .error = CPROGRESS_ERROR_INVAL };
+
+  cprogress_format_t format = { .displaychunks = (cprogress_displaychunk_t *) displaychunks };
+  cprogress_error_t error = cprogress_format_inspect(&format);
+  if (error) return (cprogress_t) { .error = error };
+
+  cprogress_t cprogress = cprogress_create_base(&cprogress_defaultallocator, thread_count, 1, 0, 0);
+  if (cprogress.error) return cprogress;
+
+  format.refcount = 1;
+  format.is_pinned = 1;
+  *cprogress.formats[0] = format;
+  cprogress.displaychunk_types = format.displaychunk_types;
+
+  return cprogress;
+}
+
+/* shares a format from cprogress_format_create(...), taking a reference */
+cprogress_t cprogress_create_withformat(cprogress_format_t *format, int thread_count) {
+  if (!format || format->is_pinned) return (cprogress_t) { .error = CPROGRESS_ERROR_INVAL };
+
+  cprogress_t cprogress = cprogress_create_base(&cprogress_defaultallocator, thread_count, 0, 0, 0);
+  if (cprogress.error) return cprogress;
+
+  cprogress_format_retain(format);
+  cprogress.formats[0] = format;
+  cprogress.formats_length = 1;
+  cprogress.displaychunk_types = format->displaychunk_types;
+
+  return cprogress;
+}
+
+/* everything it ever allocates comes from [allocator], or the default one when NULL */
+cprogress_t cprogress_create_withallocator(const char *fmt, int thread_count, const cprogress_allocator_t *allocator) {
+  if (!fmt) return (cprogress_t) { .error = CPROGRESS_ERROR_INVAL };
+  if (!allocator) allocator = &cprogress_defaultallocator;
+
+  /* pass 1: only count, so that the arena is sized exactly */
+  cprogress_format_t counting = {};
+  cprogress_error_t error = cprogress_parseformat(&counting, fmt);
+  if (error) return (cprogress_t) { .error = error };
+
+  /* pass 2: fill */
+  cprogress_t cprogress = cprogress_create_base(allocator, thread_count, 1, counting.displaychunks_length, counting.literals_length);
+  if (cprogress.error) return cprogress;
+  if ((error = cprogress_parseformat(cprogress.formats[0], fmt))) _cprogress_create_returnerror(error);
+  cprogress.displaychunk_types = cprogress.formats[0]->displaychunk_types;
+
+  return cprogress;
+}
+
+cprogress_t cprogress_create(const char *fmt, int thread_count) {
+  return cprogress_create_withallocator(fmt, thread_count, &cprogress_defaultallocator);
+}
+
+/*
+  everything updaters touch is in one shared mapping, so processes forked afterwards update
+  it directly; slots are fixed to [thread_count], the pool doesn't grow
+*/
+cprogress_t cprogress_create_shared(const char *fmt, int thread_count) {
+  cprogress_t cprogress = cprogress_create_withallocator(fmt, thread_count, &cprogress_sharedallocator);
+  cprogress.is_shared = !cprogress.error;
+  return cprogress;
+}
 
+/*
+  as cprogress_create_shared(...), in a segment other processes open by [name] (see shm_open(3)),
+  e.g. tools/cprogress-top.c; it is unlinked by cprogress_destroy(...)
+*/
+cprogress_t cprogress_create_named(const char *fmt, int thread_count, const char *name) {
+  if (!name || !*name || strlen(name) >= CPROGRESS_SHAREDNAME_MAXLEN) return (cprogress_t) { .error = CPROGRESS_ERROR_INVAL };
+
+  cprogress_allocator_t allocator = { cprogress_named_alloc, cprogress_named_free, (void *) name };
+  cprogress_t cprogress = cprogress_create_withallocator(fmt, thread_count, &allocator);
+  if (cprogress.error == CPROGRESS_ERROR_INTERNAL && errno == EEXIST) cprogress.error = CPROGRESS_ERROR_EXIST;
+  if (cprogress.error) return cprogress;
+
+  /* the segment holds the arena only, anything later (e.g. a trace) is shared without a name */
+  strcpy(cprogress.shared_name, name);
+  cprogress.allocator = cprogress_sharedallocator;
+  cprogress.is_shared = 1;
+
+  cprogress_sharedheader_t *header = (cprogress_sharedheader_t *) ((char *) cprogress.arena - CPROGRESS_SHAREDHEADER_SIZE);
+  header->threadinfo_size = sizeof(cprogress_threadinfo_t);
+  header->threadinfos_offset = (char *) cprogress.threadinfo_segments[0] - (char *) header;
+  header->threadinfos_length = cprogress.threadinfos_length;
+  __atomic_store_n(&header->magic, CPROGRESS_SHARED_MAGIC, __ATOMIC_RELEASE);
   return cprogress;
 }
 
 
-#define _cprogress_destroy_tryfree(v) if (v) { free(v); v = NULL; }
 void cprogress_destroy(cprogress_t *cprogress) {
   if (cprogress) {
-    _cprogress_destroy_tryfree(cprogress->displaychunks);
-    cprogress_stralloc_destroy(&cprogress->stralloc);
-    if (cprogress->threadinfos) {
-      cprogress_threadinfo_foreach(cprogress, threadinfo) {
-        cprogress_threadinfo_abort(threadinfo);
+    for (size_t i = 0; i < cprogress->formats_length; ++i) {
+      cprogress_format_release(cprogress->formats[i]);
+      cprogress->formats[i] = NULL;
+    }
+    cprogress->formats_length = 0;
+
+    /* segment 0, the format it was created with and the event queue are in the arena */
+    for (size_t k = 1; k < CPROGRESS_THREADINFO_SEGMENT_MAXLEN; ++k) {
+      if (cprogress->threadinfo_segments[k]) {
+        cprogress_allocator_free(&cprogress->allocator, cprogress->threadinfo_segments[k],
+          cprogress_threadinfo_segmentlength(cprogress, k) * sizeof(cprogress_threadinfo_t));
+        cprogress->threadinfo_segments[k] = NULL;
       }
-      _cprogress_destroy_tryfree(cprogress->threadinfos);
     }
+    if (cprogress->trace) {
+      cprogress_allocator_free(&cprogress->allocator, cprogress->trace,
+        sizeof(cprogress_trace_t) + cprogress->trace->records_length * sizeof(cprogress_tracerecord_t));
+      cprogress->trace = NULL;
+    }
+    if (cprogress->export_buf) {
+      if (cprogress->export_type == CPROGRESS_EXPORT_JSONLINES) close(cprogress->export_fd);
+      cprogress_allocator_free(&cprogress->allocator, cprogress->export_buf, CPROGRESS_EXPORTBUFFER_LENGTH);
+      cprogress->export_buf = NULL;
+      cprogress->export_type = 0;
+    }
+    if (cprogress->record_buf) {
+      cprogress_flushrecord(cprogress);
+      close(cprogress->record_fd);
+      cprogress_allocator_free(&cprogress->allocator, cprogress->record_buf, CPROGRESS_RECORDBUFFER_LENGTH);
+      cprogress->record_buf = NULL;
+    }
+    if (cprogress->arena) {
+      if (cprogress->shared_name[0]) cprogress_named_free(cprogress->arena, cprogress->arena_size, cprogress->shared_name);
+      else cprogress_allocator_free(&cprogress->allocator, cprogress->arena, cprogress->arena_size);
+      cprogress->arena = NULL;
+    }
+  }
+}
+
+
+
+/*----------------------------------------------------------------------------
+| format
+----------------------------------------------------------------------------*/
+
+/* parsed into one allocation from [allocator], or the default one when NULL, with one reference held by the caller */
+cprogress_format_t *cprogress_format_create_withallocator(const char *fmt, cprogress_error_t *error,
+  const cprogress_allocator_t *allocator) {
+  cprogress_error_t dummy;
+  if (!error) error = &dummy;
+  if (!allocator) allocator = &cprogress_defaultallocator;
+  if (!fmt) {
+    *error = CPROGRESS_ERROR_INVAL;
+    return NULL;
+  }
+
+  /* pass 1: only count */
+  cprogress_format_t counting = {};
+  if ((*error = cprogress_parseformat(&counting, fmt))) return NULL;
+
+  size_t block_size = 0;
+  cprogress_arena_carve(&block_size, sizeof(cprogress_format_t), sizeof(void *));
+  size_t displaychunks_offset = cprogress_arena_carve(&block_size,
+    counting.displaychunks_length * sizeof(cprogress_displaychunk_t), sizeof(void *));
+  size_t literals_offset = cprogress_arena_carve(&block_size, counting.literals_length, 1);
+
+  char *block = (char *) cprogress_allocator_alloc(allocator, block_size, sizeof(void *));
+  if (!block) {
+    *error = CPROGRESS_ERROR_INTERNAL;
+    return NULL;
+  }
+
+  /* pass 2: fill */
+  cprogress_format_t *format = (cprogress_format_t *) block;
+  format->refcount = 1;
+  format->block = block;
+  format->block_size = block_size;
+  format->allocator = *allocator;
+  format->displaychunks = (cprogress_displaychunk_t *) (block + displaychunks_offset);
+  if (counting.literals_length) format->literals = block + literals_offset;
+  if ((*error = cprogress_parseformat(format, fmt))) {
+    cprogress_allocator_free(&format->allocator, block, block_size);
+    return NULL;
+  }
+
+  return format;
+}
+
+cprogress_format_t *cprogress_format_create(const char *fmt, cprogress_error_t *error) {
+  return cprogress_format_create_withallocator(fmt, error, NULL);
+}
+
+void cprogress_format_retain(cprogress_format_t *format) {
+  if (format) __atomic_add_fetch(&format->refcount, 1, __ATOMIC_RELAXED);
+}
+
+void cprogress_format_release(cprogress_format_t *format) {
+  if (format && __atomic_sub_fetch(&format->refcount, 1, __ATOMIC_ACQ_REL) == 0 && format->block)
+    cprogress_allocator_free(&format->allocator, format->block, format->block_size);
+}
+
+
+/*
+  returns the format_index for cprogress_updatethread_format(...), or CPROGRESS_UNDEF when full
+  or [format] is pinned to an instance's arena
+*/
+int cprogress_attachformat(cprogress_t *cprogress, cprogress_format_t *format) {
+  if (!cprogress || !format || format->is_pinned || cprogress->formats_length >= CPROGRESS_FORMAT_MAXLEN)
+    return CPROGRESS_UNDEF;
+
+  cprogress_format_retain(format);
+  cprogress->formats[cprogress->formats_length] = format;
+  cprogress->displaychunk_types |= format->displaychunk_types;
+  return cprogress->formats_length++;
+}
+
+
+
+/*----------------------------------------------------------------------------
+| seqlock
+----------------------------------------------------------------------------*/
+
+/* there's only one updater per thread_index, so no atomic rmw is needed for writing */
+void cprogress_threadinfo_writebegin(cprogress_threadinfo_t *threadinfo) {
+  __atomic_store_n(&threadinfo->seq, threadinfo->seq + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+void cprogress_threadinfo_writeend(cprogress_threadinfo_t *threadinfo) {
+  __atomic_store_n(&threadinfo->seq, threadinfo->seq + 1, __ATOMIC_RELEASE);
+}
+
+/* must be called between writebegin and writeend, returns non-zero if it was running */
+int cprogress_threadinfo_markstopped(cprogress_threadinfo_t *threadinfo) {
+  if (!threadinfo->is_running) return 0;
+
+  threadinfo->is_running = 0;
+  ++threadinfo->stop_count;
+  cprogress_probe2(thread_finish, cprogress_threadinfo_getindex(threadinfo), threadinfo->stop_count);
+  return 1;
+}
+
+void cprogress_threadinfo_snapshot(const cprogress_threadinfo_t *threadinfo, cprogress_threadsnapshot_t *snapshot) {
+  if (!threadinfo || !snapshot) return;
+
+  int retry_count = 0;
+  for (; ; ++retry_count) {
+    uint32_t seq = __atomic_load_n(&threadinfo->seq, __ATOMIC_ACQUIRE);
+    if (seq & 1 && retry_count < CPROGRESS_SNAPSHOT_MAXRETRY) {
+      if (retry_count < CPROGRESS_SNAPSHOT_SPINRETRY) cprogress_cpurelax();
+      else sched_yield();
+      continue;
+    }
+
+    snapshot->is_running = threadinfo->is_running;
+    snapshot->start_count = threadinfo->start_count;
+    snapshot->stop_count = threadinfo->stop_count;
+    memcpy(snapshot->title, threadinfo->title, CPROGRESS_TITLE_MAXLEN);
+    snapshot->percentage = threadinfo->percentage;
+    snapshot->done = threadinfo->done;
+    snapshot->total = threadinfo->total;
+    snapshot->is_indeterminate = threadinfo->is_indeterminate;
+    snapshot->format_index = threadinfo->format_index;
+
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (__atomic_load_n(&threadinfo->seq, __ATOMIC_RELAXED) == seq || retry_count >= CPROGRESS_SNAPSHOT_MAXRETRY) break;
+  }
+  if (retry_count >= CPROGRESS_SNAPSHOT_MAXRETRY) {
+    /* maybe torn, but still drawable */
+    if (!(snapshot->percentage >= 0)) snapshot->percentage = 0;
+    if (snapshot->percentage > 100) snapshot->percentage = 100;
+  }
+
+  snapshot->thread_index = threadinfo->thread_index;
+  snapshot->tick_count = __atomic_load_n(&threadinfo->tick_count, __ATOMIC_RELAXED);
+  snapshot->title[CPROGRESS_TITLE_MAXLEN - 1] = 0;
+  snapshot->is_parent = __atomic_load_n(&threadinfo->rollup_weight, __ATOMIC_RELAXED) != 0;
+  if (snapshot->is_parent)
+    snapshot->percentage = __atomic_load_n(&threadinfo->rollup_value, __ATOMIC_RELAXED) * 100.0 / CPROGRESS_ROLLUP_SCALE;
+  snapshot->is_just_stopped = snapshot->stop_count != threadinfo->rendered_stop_count;
+}
+
+
+
+/*----------------------------------------------------------------------------
+| task/thread storage
+----------------------------------------------------------------------------*/
+
+size_t cprogress_threadinfo_segmentlength(const cprogress_t *cprogress, size_t segment) {
+  return (size_t) 1 << (cprogress->threadinfo_segmentshift + (segment? segment - 1: 0));
+}
+
+size_t cprogress_threadinfo_segmentbegin(const cprogress_t *cprogress, size_t segment) {
+  return segment? (size_t) 1 << (cprogress->threadinfo_segmentshift + segment - 1): 0;
+}
+
+size_t cprogress_threadinfo_segmentof(const cprogress_t *cprogress, size_t thread_index) {
+  size_t quotient = thread_index >> cprogress->threadinfo_segmentshift;
+  return quotient? sizeof(unsigned long long) * 8 - __builtin_clzll(quotient): 0;
+}
+
+/* segments are never freed or moved until cprogress_destroy(...), so readers need no lock */
+/* threadinfos are zeroed */
+void cprogress_threadinfo_initsegment(cprogress_t *cprogress, cprogress_threadinfo_t *threadinfos, size_t segment) {
+  size_t length = cprogress_threadinfo_segmentlength(cprogress, segment);
+  size_t begin = cprogress_threadinfo_segmentbegin(cprogress, segment);
+  for (size_t i = 0; i < length; ++i) {
+    threadinfos[i].is_valid = 1;
+    threadinfos[i].thread_index = begin + i;
+    threadinfos[i].eventqueue = cprogress->eventqueue;
+    threadinfos[i].trace = cprogress->trace;
+  }
+}
+
+cprogress_threadinfo_t *cprogress_threadinfo_ensuresegment(cprogress_t *cprogress, size_t segment) {
+  if (segment >= CPROGRESS_THREADINFO_SEGMENT_MAXLEN) return NULL;
+  /* other processes would never see a segment mapped later */
+  if (cprogress->is_shared && segment) return NULL;
+
+  cprogress_threadinfo_t *threadinfos = __atomic_load_n(&cprogress->threadinfo_segments[segment], __ATOMIC_ACQUIRE);
+  if (threadinfos) return threadinfos;
+
+  size_t segment_size = cprogress_threadinfo_segmentlength(cprogress, segment) * sizeof(cprogress_threadinfo_t);
+  threadinfos = (cprogress_threadinfo_t *) cprogress_allocator_alloc(&cprogress->allocator, segment_size, CPROGRESS_ARENA_ALIGN);
+  if (!threadinfos) return NULL;
+  cprogress_threadinfo_initsegment(cprogress, threadinfos, segment);
+
+  /* someone else may be growing the same segment, the loser frees its copy */
+  cprogress_threadinfo_t *expected = NULL;
+  if (!__atomic_compare_exchange_n(&cprogress->threadinfo_segments[segment], &expected, threadinfos,
+    0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+    cprogress_allocator_free(&cprogress->allocator, threadinfos, segment_size);
+    return expected;
+  }
+  return threadinfos;
+}
+
+/* NULL when out of range; segments below threadinfos_length are always installed */
+cprogress_threadinfo_t *cprogress_threadinfo_at(cprogress_t *cprogress, size_t thread_index) {
+  if (!cprogress || thread_index >= cprogress_getthreadinfos_length(cprogress)) return NULL;
+
+  size_t segment = cprogress_threadinfo_segmentof(cprogress, thread_index);
+  cprogress_threadinfo_t *threadinfos = __atomic_load_n(&cprogress->threadinfo_segments[segment], __ATOMIC_ACQUIRE);
+  if (!threadinfos) return NULL;
+  return &threadinfos[thread_index - cprogress_threadinfo_segmentbegin(cprogress, segment)];
+}
+
+cprogress_threadinfo_t *cprogress_threadinfo_first(cprogress_t *cprogress) {
+  return cprogress_threadinfo_at(cprogress, 0);
+}
+
+cprogress_threadinfo_t *cprogress_threadinfo_next(cprogress_t *cprogress, cprogress_threadinfo_t *threadinfo) {
+  return cprogress_threadinfo_at(cprogress, cprogress_threadinfo_getindex(threadinfo) + 1);
+}
+
+
+
+/*----------------------------------------------------------------------------
+| task/thread hierarchy
+----------------------------------------------------------------------------*/
+
+/* carry the change of threadinfo's rollup_value to its ancestors, O(depth) */
+void cprogress_threadinfo_propagate(cprogress_threadinfo_t *threadinfo, int64_t delta) {
+  cprogress_threadinfo_t *child = threadinfo;
+  cprogress_threadinfo_t *parent = __atomic_load_n(&child->parent_threadinfo, __ATOMIC_ACQUIRE);
+  while (delta && parent) {
+    int64_t weight_total = __atomic_load_n(&parent->rollup_weight, __ATOMIC_RELAXED);
+    int64_t added = delta * __atomic_load_n(&child->weight, __ATOMIC_RELAXED);
+    int64_t old_accum = __atomic_fetch_add(&parent->rollup_accum, added, __ATOMIC_RELAXED);
+    int64_t new_accum = old_accum + added;
+
+    /* old and new accum are neighbours in the order of all changes, so adding up these
+      deltas never drifts from new_accum / weight_total */
+    delta = new_accum / weight_total - old_accum / weight_total;
+    if (delta) __atomic_fetch_add(&parent->rollup_value, delta, __ATOMIC_RELAXED);
+
+    child = parent;
+    parent = __atomic_load_n(&child->parent_threadinfo, __ATOMIC_ACQUIRE);
+  }
+}
+
+/* updaters of a child call this, a parent's own percentage is not counted */
+void cprogress_threadinfo_rollup(cprogress_threadinfo_t *threadinfo, float percentage) {
+  if (!__atomic_load_n(&threadinfo->parent_threadinfo, __ATOMIC_RELAXED) ||
+    __atomic_load_n(&threadinfo->rollup_weight, __ATOMIC_RELAXED)) return;
+
+  int64_t value = percentage * (CPROGRESS_ROLLUP_SCALE / 100);
+  cprogress_threadinfo_propagate(threadinfo, value - __atomic_exchange_n(&threadinfo->rollup_value, value, __ATOMIC_RELAXED));
+}
+
+/* recount rollup_value after weights changed */
+void cprogress_threadinfo_recount(cprogress_threadinfo_t *threadinfo) {
+  int64_t weight_total = __atomic_load_n(&threadinfo->rollup_weight, __ATOMIC_RELAXED);
+  int64_t value;
+  if (weight_total) {
+    value = __atomic_load_n(&threadinfo->rollup_accum, __ATOMIC_RELAXED) / weight_total;
+  } else {
+    cprogress_threadsnapshot_t snapshot;
+    cprogress_threadinfo_snapshot(threadinfo, &snapshot);
+    value = snapshot.percentage * (CPROGRESS_ROLLUP_SCALE / 100);
+  }
+  cprogress_threadinfo_propagate(threadinfo, value - __atomic_exchange_n(&threadinfo->rollup_value, value, __ATOMIC_RELAXED));
+}
+
+int cprogress_attachthread(cprogress_t *cprogress, int thread_index, int parent_index, uint32_t weight) {
+  if (!cprogress || !weight) return CPROGRESS_ERROR_INVAL;
+
+  size_t length = cprogress_getthreadinfos_length(cprogress);
+  if (thread_index < 0 || thread_index >= length || parent_index < 0 || parent_index >= length)
+    return CPROGRESS_ERROR_INVAL;
+
+  /* no cycle */
+  for (int ancestor = parent_index; ancestor != CPROGRESS_UNDEF;
+    ancestor = (int) __atomic_load_n(&cprogress_getthreadinfo(cprogress, ancestor).parent, __ATOMIC_RELAXED) - 1) {
+    if (ancestor == thread_index) return CPROGRESS_ERROR_INVAL;
   }
+
+  cprogress_detachthread(cprogress, thread_index);
+
+  cprogress_threadinfo_t *threadinfo = &cprogress_getthreadinfo(cprogress, thread_index);
+  cprogress_threadinfo_t *parent = &cprogress_getthreadinfo(cprogress, parent_index);
+
+  /* count the child as it is now, then the parent as a whole */
+  cprogress_threadinfo_recount(threadinfo);
+  __atomic_store_n(&threadinfo->weight, weight, __ATOMIC_RELAXED);
+  __atomic_fetch_add(&parent->rollup_accum,
+    (int64_t) weight * __atomic_load_n(&threadinfo->rollup_value, __ATOMIC_RELAXED), __ATOMIC_RELAXED);
+  __atomic_fetch_add(&parent->rollup_weight, weight, __ATOMIC_RELAXED);
+  __atomic_store_n(&threadinfo->parent_threadinfo, parent, __ATOMIC_RELEASE);
+  __atomic_store_n(&threadinfo->parent, parent_index + 1, __ATOMIC_RELEASE);
+  cprogress_threadinfo_recount(parent);
+
+  __atomic_store_n(&cprogress->has_hierarchy, 1, __ATOMIC_RELEASE);
+  return CPROGRESS_ERROR_OK;
+}
+
+void cprogress_detachthread(cprogress_t *cprogress, int thread_index) {
+  if (!cprogress || thread_index < 0 || thread_index >= cprogress_getthreadinfos_length(cprogress)) return;
+
+  cprogress_threadinfo_t *threadinfo = &cprogress_getthreadinfo(cprogress, thread_index);
+  cprogress_threadinfo_t *parent = __atomic_load_n(&threadinfo->parent_threadinfo, __ATOMIC_ACQUIRE);
+  if (!parent) return;
+
+  uint32_t weight = __atomic_load_n(&threadinfo->weight, __ATOMIC_RELAXED);
+  __atomic_store_n(&threadinfo->parent, 0, __ATOMIC_RELEASE);
+  __atomic_store_n(&threadinfo->parent_threadinfo, NULL, __ATOMIC_RELEASE);
+  __atomic_fetch_sub(&parent->rollup_weight, weight, __ATOMIC_RELAXED);
+  __atomic_fetch_sub(&parent->rollup_accum,
+    (int64_t) weight * __atomic_load_n(&threadinfo->rollup_value, __ATOMIC_RELAXED), __ATOMIC_RELAXED);
+  cprogress_threadinfo_recount(parent);
+}
+
+void cprogress_collapsethread(cprogress_t *cprogress, int thread_index, int is_collapsed) {
+  if (!cprogress || thread_index < 0 || thread_index >= cprogress_getthreadinfos_length(cprogress)) return;
+
+  __atomic_store_n(&cprogress_getthreadinfo(cprogress, thread_index).is_collapsed, is_collapsed, __ATOMIC_RELAXED);
 }
 
 
@@ -628,35 +2354,81 @@ void cprogress_destroy(cprogress_t *cprogress) {
 void cprogress_threadinfo_start(cprogress_threadinfo_t *threadinfo) {
   if (!threadinfo) return;
 
-  if (threadinfo->title) {
-    free(threadinfo->title);
-  }
-  threadinfo->title = NULL;
+  cprogress_threadinfo_writebegin(threadinfo);
+  threadinfo->title[0] = 0;
   threadinfo->percentage = 0;
+  threadinfo->done = 0;
+  threadinfo->total = 0;
+  threadinfo->is_indeterminate = 0;
+  threadinfo->format_index = 0;
   threadinfo->is_running = 1;
+  ++threadinfo->start_count;
+  cprogress_threadinfo_writeend(threadinfo);
+
+  cprogress_probe2(thread_start, cprogress_threadinfo_getindex(threadinfo), threadinfo->start_count);
+  if (threadinfo->trace) cprogress_pushtrace(threadinfo->trace, CPROGRESS_TRACE_START, cprogress_threadinfo_getindex(threadinfo),
+    cprogress_getnanotime(), threadinfo->percentage, NULL);
+
+  cprogress_threadinfo_rollup(threadinfo, 0);
+  cprogress_pushevent(threadinfo->eventqueue, CPROGRESS_EVENT_THREADSTART, cprogress_threadinfo_getindex(threadinfo));
 }
 
 void cprogress_threadinfo_abort(cprogress_threadinfo_t *threadinfo) {
+  if (!threadinfo || !threadinfo->is_running) return;
+
+  cprogress_threadinfo_writebegin(threadinfo);
+  cprogress_threadinfo_markstopped(threadinfo);
+  cprogress_threadinfo_writeend(threadinfo);
+  /* keep everything else, cprogress_render(...) shows the data here for the last time */
+  if (threadinfo->trace) cprogress_pushtrace(threadinfo->trace, CPROGRESS_TRACE_FINISH, cprogress_threadinfo_getindex(threadinfo),
+    cprogress_getnanotime(), threadinfo->percentage, NULL);
+
+  cprogress_pushevent(threadinfo->eventqueue, CPROGRESS_EVENT_THREADFINISH, cprogress_threadinfo_getindex(threadinfo));
+}
+
+/*
+  for a slot whose updater is gone for good, e.g. a worker process that crashed: a write it left
+  half done is closed, and the slot is stopped as by cprogress_threadinfo_abort(...)
+*/
+void cprogress_threadinfo_recover(cprogress_threadinfo_t *threadinfo) {
   if (!threadinfo) return;
 
-  threadinfo->is_running = 0;
-  threadinfo->is_just_stopped = 1;
-  /* let cprogress_threadinfo_start(...) and cprogress_abort(...) clean up everything
-    because cprogress_render(...) uses the data here */
+  uint32_t seq = __atomic_load_n(&threadinfo->seq, __ATOMIC_ACQUIRE);
+  if (seq & 1) __atomic_store_n(&threadinfo->seq, seq + 1, __ATOMIC_RELEASE);
+
+  cprogress_threadinfo_writebegin(threadinfo);
+  threadinfo->title[CPROGRESS_TITLE_MAXLEN - 1] = 0;
+  if (!(threadinfo->percentage >= 0)) threadinfo->percentage = 0;
+  if (threadinfo->percentage > 100) threadinfo->percentage = 100;
+  int is_stopped = cprogress_threadinfo_markstopped(threadinfo);
+  cprogress_threadinfo_writeend(threadinfo);
+
+  if (is_stopped) {
+    if (threadinfo->trace) cprogress_pushtrace(threadinfo->trace, CPROGRESS_TRACE_FINISH, cprogress_threadinfo_getindex(threadinfo),
+      cprogress_getnanotime(), threadinfo->percentage, NULL);
+    cprogress_pushevent(threadinfo->eventqueue, CPROGRESS_EVENT_THREADFINISH, cprogress_threadinfo_getindex(threadinfo));
+  }
 }
 
 void cprogress_startthread(cprogress_t *cprogress, int thread_index) {
-  if (!cprogress || thread_index < 0 || thread_index >= cprogress->threadinfos_length) return;
+  if (!cprogress || thread_index < 0 || thread_index >= cprogress_getthreadinfos_length(cprogress)) return;
 
   cprogress_threadinfo_start(&cprogress_getthreadinfo(cprogress, thread_index));
 }
 
 void cprogress_abortthread(cprogress_t *cprogress, int thread_index) {
-  if (!cprogress || thread_index < 0 || thread_index >= cprogress->threadinfos_length) return;
+  if (!cprogress || thread_index < 0 || thread_index >= cprogress_getthreadinfos_length(cprogress)) return;
 
   cprogress_threadinfo_abort(&cprogress_getthreadinfo(cprogress, thread_index));
 }
 
+void cprogress_recoverthread(cprogress_t *cprogress, int thread_index) {
+  if (!cprogress || thread_index < 0 || thread_index >= cprogress_getthreadinfos_length(cprogress)) return;
+
+  cprogress_threadinfo_recover(&cprogress_getthreadinfo(cprogress, thread_index));
+  cprogress_recoverevents(cprogress->eventqueue);
+}
+
 void cprogress_startallthreads(cprogress_t *cprogress) {
   if (!cprogress) return;
 
@@ -666,6 +2438,65 @@ void cprogress_startallthreads(cprogress_t *cprogress) {
 }
 
 
+/*----------------------------------------------------------------------------
+| task/thread pool
+----------------------------------------------------------------------------*/
+
+#define _cprogress_freelist_index(head) ((uint32_t) (head))
+#define _cprogress_freelist_make(head, index) ((((head) >> 32) + 1) << 32 | (uint32_t) (index))
+
+int cprogress_acquire(cprogress_t *cprogress) {
+  if (!cprogress) return CPROGRESS_UNDEF;
+
+  /* reuse a released one first */
+  uint64_t head = __atomic_load_n(&cprogress->threadinfo_freelist, __ATOMIC_ACQUIRE);
+  while (_cprogress_freelist_index(head)) {
+    cprogress_threadinfo_t *threadinfo = &cprogress_getthreadinfo(cprogress, _cprogress_freelist_index(head) - 1);
+    uint32_t next = __atomic_load_n(&threadinfo->freelist_next, __ATOMIC_RELAXED);
+    if (__atomic_compare_exchange_n(&cprogress->threadinfo_freelist, &head, _cprogress_freelist_make(head, next),
+      1, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+      cprogress_threadinfo_start(threadinfo);
+      return cprogress_threadinfo_getindex(threadinfo);
+    }
+  }
+
+  /* take a never used one, growing a segment if necessary */
+  size_t thread_index = __atomic_fetch_add(&cprogress->threadinfos_reserved, 1, __ATOMIC_RELAXED);
+  size_t segment = cprogress_threadinfo_segmentof(cprogress, thread_index);
+  cprogress_threadinfo_t *threadinfos = NULL;
+  /*
+    threadinfos_length only goes over installed segments, so that every index below it can be
+    dereferenced; a segment below ours may still be grown by another thread, we help with it
+  */
+  for (size_t i = 0; i <= segment && thread_index <= INT32_MAX; ++i) {
+    threadinfos = cprogress_threadinfo_ensuresegment(cprogress, i);
+    if (!threadinfos) break;
+  }
+  if (!threadinfos || thread_index > INT32_MAX) return CPROGRESS_UNDEF; /* the reserved index is lost, that's fine */
+
+  size_t length = __atomic_load_n(&cprogress->threadinfos_length, __ATOMIC_RELAXED);
+  while (length <= thread_index && !__atomic_compare_exchange_n(&cprogress->threadinfos_length, &length, thread_index + 1,
+    1, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+
+  cprogress_threadinfo_t *threadinfo = &threadinfos[thread_index - cprogress_threadinfo_segmentbegin(cprogress, segment)];
+  cprogress_threadinfo_start(threadinfo);
+  return thread_index;
+}
+
+void cprogress_release(cprogress_t *cprogress, int thread_index) {
+  if (!cprogress || thread_index < 0 || thread_index >= cprogress_getthreadinfos_length(cprogress)) return;
+
+  cprogress_threadinfo_t *threadinfo = &cprogress_getthreadinfo(cprogress, thread_index);
+  cprogress_threadinfo_abort(threadinfo);
+
+  uint64_t head = __atomic_load_n(&cprogress->threadinfo_freelist, __ATOMIC_RELAXED);
+  do {
+    __atomic_store_n(&threadinfo->freelist_next, _cprogress_freelist_index(head), __ATOMIC_RELAXED);
+  } while (!__atomic_compare_exchange_n(&cprogress->threadinfo_freelist, &head, _cprogress_freelist_make(head, thread_index + 1),
+    1, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+
 /*----------------------------------------------------------------------------
 | view basic
 ----------------------------------------------------------------------------*/
@@ -681,17 +2512,19 @@ size_t cprogress_measurechar(const char *buf) {
   return len <= 1? len: 2;
 }
 
-size_t cprogress_measuredisplaychunk(cprogress_displaychunk_t *displaychunk, const char *str, size_t autospan_width) {
+size_t cprogress_measurestring(const char *str) {
+  size_t width = 0;
+  while (*str) {
+    width += cprogress_measurechar(str);
+    str += cprogress_charlen(str);
+  }
+  return width;
+}
+
+size_t cprogress_measuredisplaychunk(const cprogress_displaychunk_t *displaychunk, const char *str, size_t autospan_width) {
   if (displaychunk->span_width != CPROGRESS_UNDEF) return displaychunk->span_width;
   if (displaychunk->type == CPROGRESS_DISPLAYCHUNK_LITERAL) return displaychunk->literal_length;
-  if (str) {
-    size_t width = 0;
-    while (*str) {
-      str += cprogress_charlen(str);
-      width += cprogress_measurechar(str);
-    }
-    return width;
-  }
+  if (str) return cprogress_measurestring(str);
   return autospan_width;
 }
 
@@ -724,58 +2557,277 @@ size_t cprogress_snprintw(char *buf, size_t buf_len, const char *literal, size_t
   return written_length;
 }
 
-/* it must to be one-width-per-char as in ASCII, so there's no need to implement one */
-#define cprogress_sprintpercentage(buf, buf_len, percentage) snprintf(buf, buf_len, "%.2f", percentage)
+/*----------------------------------------------------------------------------
+| number formatting, used for every line of every frame so no printf here
+----------------------------------------------------------------------------*/
 
+static const char cprogress_digitpairs[201] =
+  "0001020304050607080910111213141516171819202122232425262728293031323334353637383940414243444546474849"
+  "5051525354555657585960616263646566676869707172737475767778798081828384858687888990919293949596979899";
 
-size_t cprogress_writeliteral(char *buf, size_t buf_len, const char *literal, size_t alloc_width) {
-  if (alloc_width == CPROGRESS_UNDEF && !literal) {
-    /* what should we draw? */
-    return 0;
-  }
+/* buf holds at least 21 bytes, returns length without the terminating zero */
+size_t cprogress_utoa(char *buf, uint64_t value) {
+  char digits[20];
+  char *ptr = digits + sizeof(digits);
 
-  if (!literal) {
-    size_t written_length = 0;
-    size_t display_width = 0;
-    while (written_length < buf_len && display_width < alloc_width) {
-      buf[written_length] = ' ';
-      ++written_length; ++display_width;
-    }
-    return written_length;
+  /* two digits a time, from the least significant pair */
+  while (value >= 100) {
+    ptr -= 2;
+    memcpy(ptr, cprogress_digitpairs + value % 100 * 2, 2);
+    value /= 100;
+  }
+  if (value >= 10) {
+    ptr -= 2;
+    memcpy(ptr, cprogress_digitpairs + value * 2, 2);
+  } else {
+    *--ptr = '0' + value;
   }
 
-  return cprogress_snprintw(buf, buf_len, literal, alloc_width);
+  size_t length = digits + sizeof(digits) - ptr;
+  memcpy(buf, ptr, length);
+  buf[length] = 0;
+  return length;
 }
 
-size_t cprogress_writepercentage(char *buf, size_t buf_len, float percentage, size_t alloc_width) {
-  char percentage_string[7] = {};
-  cprogress_sprintpercentage(percentage_string, 6, percentage);
-  return cprogress_writeliteral(buf, buf_len, percentage_string, alloc_width);
+/* 1,234,567, buf holds at least 27 bytes */
+size_t cprogress_utoa_grouped(char *buf, uint64_t value) {
+  char digits[21];
+  size_t digits_length = cprogress_utoa(digits, value);
+
+  size_t length = 0;
+  size_t group_length = digits_length % 3? digits_length % 3: 3;
+  for (size_t i = 0; i < digits_length; i += group_length, group_length = 3) {
+    if (i) buf[length++] = ',';
+    memcpy(buf + length, digits + i, group_length);
+    length += group_length;
+  }
+  buf[length] = 0;
+  return length;
 }
 
-size_t cprogress_writeprogressbar(char *buf, size_t buf_len, char fill_char, float percentage) {
-  int left_length = buf_len * (percentage / 100.0);
-
-  int curr = 0;
-  while (curr < left_length) buf[curr++] = fill_char;
-  while (curr < buf_len) buf[curr++] = ' ';
+/* [whole].[fraction] with fraction_width digits, fraction_width is 1 or 2 */
+size_t cprogress_sprintfixed(char *buf, uint64_t whole, uint32_t fraction, int fraction_width) {
+  size_t length = cprogress_utoa(buf, whole);
+  buf[length++] = '.';
+  if (fraction_width == 2) {
+    memcpy(buf + length, cprogress_digitpairs + fraction * 2, 2);
+    length += 2;
+  } else {
+    buf[length++] = '0' + fraction;
+  }
+  buf[length] = 0;
+  return length;
+}
 
-  return buf_len;
+size_t cprogress_sprintpercentage(char *buf, float percentage) {
+  uint64_t hundredths = percentage > 0? (uint64_t) (percentage * 100 + 0.5f): 0;
+  return cprogress_sprintfixed(buf, hundredths / 100, hundredths % 100, 2);
 }
 
+/* 512 B, 1.2 GiB, rounded to one decimal */
+size_t cprogress_sprintbytes(char *buf, uint64_t bytes) {
+  static const char *units[] = { " B", " KiB", " MiB", " GiB", " TiB", " PiB", " EiB" };
+
+  int unit = 0;
+  while (unit < 6 && bytes >> (10 * (unit + 1))) ++unit;
+
+  size_t length = 0;
+  if (!unit) {
+    length = cprogress_utoa(buf, bytes);
+  } else {
+    int shift = 10 * unit;
+    uint64_t whole = bytes >> shift;
+    uint64_t fraction = ((bytes & ((1ULL << shift) - 1)) * 10 + (1ULL << (shift - 1))) >> shift;
+    if (fraction == 10) {
+      fraction = 0;
+      /* 1023.96 KiB goes 1.0 MiB rather than 1024.0 KiB */
+      if (++whole == 1024 && unit < 6) {
+        whole = 1;
+        ++unit;
+      }
+    }
+    length = cprogress_sprintfixed(buf, whole, fraction, 1);
+  }
 
-void cprogress_writeline(cprogress_t *cprogress, char *buf, size_t buf_len, size_t console_width, const char *title, float percentage) {
+  size_t unit_length = strlen(units[unit]);
+  memcpy(buf + length, units[unit], unit_length + 1);
+  return length + unit_length;
+}
 
-  char *line = buf;
-  if (!line || console_width <= 1) return;
+/* 12,345/1,000,000, or 12,345 alone when total is unknown */
+size_t cprogress_sprintcount(char *buf, uint64_t done, uint64_t total, int is_bytes) {
+  size_t length = is_bytes? cprogress_sprintbytes(buf, done): cprogress_utoa_grouped(buf, done);
+  if (total) {
+    buf[length++] = '/';
+    length += is_bytes? cprogress_sprintbytes(buf + length, total): cprogress_utoa_grouped(buf + length, total);
+  }
+  return length;
+}
 
-  char percentage_string[7] = {};
-  cprogress_sprintpercentage(percentage_string, 6, percentage);
+/* [H:]MM:SS, or --:-- when unknown */
+size_t cprogress_sprintduration(char *buf, int64_t ns) {
+  if (ns < 0) {
+    memcpy(buf, "--:--", 6);
+    return 5;
+  }
+
+  uint64_t seconds = ns / 1000000000;
+  size_t length = 0;
+  if (seconds >= 3600) {
+    length = cprogress_utoa(buf, seconds / 3600);
+    buf[length++] = ':';
+  }
+  memcpy(buf + length, cprogress_digitpairs + seconds / 60 % 60 * 2, 2);
+  buf[length + 2] = ':';
+  memcpy(buf + length + 3, cprogress_digitpairs + seconds % 60 * 2, 2);
+  buf[length + 5] = 0;
+  return length + 5;
+}
+
+/* with SI prefixes, or binary prefixes for bytes */
+size_t cprogress_sprintrate(char *buf, double rate, int is_bytes, int is_percentage) {
+  size_t length = 0;
+  if (rate < 0) {
+    memcpy(buf, "--", 2);
+    length = 2;
+  } else if (!(rate * 10 + 0.5 < 18446744073709551616.0)) {
+    /* doesn't fit the integers below, or not a number, e.g. a huge jump in no time at all */
+    memcpy(buf, "inf", 3);
+    length = 3;
+  } else if (is_percentage) {
+    uint64_t tenths = rate * 10 + 0.5;
+    length = cprogress_sprintfixed(buf, tenths / 10, tenths % 10, 1);
+    buf[length++] = '%';
+  } else if (is_bytes) {
+    length = cprogress_sprintbytes(buf, rate);
+  } else {
+    static const char *units[] = { "", "k", "M", "G", "T", "P", "E" };
+    uint64_t count = rate + 0.5;
+    uint64_t base = 1;
+    int unit = 0;
+    while (unit < 6 && count / base >= 1000) {
+      base *= 1000;
+      ++unit;
+    }
+    length = unit?
+      cprogress_sprintfixed(buf, count / base, count % base * 10 / base, 1):
+      cprogress_utoa(buf, count);
+    size_t unit_length = strlen(units[unit]);
+    memcpy(buf + length, units[unit], unit_length);
+    length += unit_length;
+  }
+
+  memcpy(buf + length, "/s", 3);
+  return length + 2;
+}
+
+size_t cprogress_sprintspinner(char *buf, uint32_t spinner_index) {
+  static const char spinner_glyphs[][CPROGRESS_SPINNER_GLYPH_MAXLEN] = CPROGRESS_SPINNER_GLYPHS;
+  size_t glyphs_length = sizeof(spinner_glyphs) / sizeof(spinner_glyphs[0]);
+
+  memcpy(buf, spinner_glyphs[spinner_index % glyphs_length], CPROGRESS_SPINNER_GLYPH_MAXLEN);
+  return strlen(buf);
+}
+
+/* text of chunks that are computed per line, only for types in the format */
+void cprogress_sprintchunks(const cprogress_format_t *format, char strings[][CPROGRESS_CHUNKSTRING_MAXLEN], const cprogress_lineinfo_t *lineinfo) {
+  uint32_t types = format->displaychunk_types;
+  int is_percentage = !lineinfo->total && !lineinfo->is_indeterminate;
+
+  if (types & 1u << CPROGRESS_DISPLAYCHUNK_PERCENTAGE) {
+    if (lineinfo->is_indeterminate) strcpy(strings[CPROGRESS_DISPLAYCHUNK_PERCENTAGE], "--");
+    else cprogress_sprintpercentage(strings[CPROGRESS_DISPLAYCHUNK_PERCENTAGE], lineinfo->percentage);
+  }
+  if (types & 1u << CPROGRESS_DISPLAYCHUNK_RATE)
+    cprogress_sprintrate(strings[CPROGRESS_DISPLAYCHUNK_RATE], lineinfo->rate, 0, is_percentage);
+  if (types & 1u << CPROGRESS_DISPLAYCHUNK_BYTERATE)
+    cprogress_sprintrate(strings[CPROGRESS_DISPLAYCHUNK_BYTERATE], lineinfo->rate, 1, is_percentage);
+  if (types & 1u << CPROGRESS_DISPLAYCHUNK_ETA)
+    cprogress_sprintduration(strings[CPROGRESS_DISPLAYCHUNK_ETA], lineinfo->eta_ns);
+  if (types & 1u << CPROGRESS_DISPLAYCHUNK_ELAPSED)
+    cprogress_sprintduration(strings[CPROGRESS_DISPLAYCHUNK_ELAPSED], lineinfo->elapsed_ns);
+  if (types & 1u << CPROGRESS_DISPLAYCHUNK_COUNT)
+    cprogress_sprintcount(strings[CPROGRESS_DISPLAYCHUNK_COUNT], lineinfo->done, lineinfo->total, 0);
+  if (types & 1u << CPROGRESS_DISPLAYCHUNK_BYTES)
+    cprogress_sprintcount(strings[CPROGRESS_DISPLAYCHUNK_BYTES], lineinfo->done, lineinfo->total, 1);
+  if (types & 1u << CPROGRESS_DISPLAYCHUNK_SPINNER)
+    cprogress_sprintspinner(strings[CPROGRESS_DISPLAYCHUNK_SPINNER], lineinfo->spinner_index);
+}
+
+
+size_t cprogress_writeliteral(char *buf, size_t buf_len, const char *literal, size_t alloc_width) {
+  if (alloc_width == CPROGRESS_UNDEF && !literal) {
+    /* what should we draw? */
+    return 0;
+  }
+
+  if (!literal) {
+    size_t written_length = 0;
+    size_t display_width = 0;
+    while (written_length < buf_len && display_width < alloc_width) {
+      buf[written_length] = ' ';
+      ++written_length; ++display_width;
+    }
+    return written_length;
+  }
+
+  return cprogress_snprintw(buf, buf_len, literal, alloc_width);
+}
+
+size_t cprogress_writepercentage(char *buf, size_t buf_len, float percentage, size_t alloc_width) {
+  char percentage_string[CPROGRESS_CHUNKSTRING_MAXLEN] = {};
+  cprogress_sprintpercentage(percentage_string, percentage);
+  return cprogress_writeliteral(buf, buf_len, percentage_string, alloc_width);
+}
+
+size_t cprogress_writeprogressbar(char *buf, size_t buf_len, char fill_char, float percentage) {
+  int left_length = buf_len * (percentage / 100.0);
+
+  int curr = 0;
+  while (curr < left_length) buf[curr++] = fill_char;
+  while (curr < buf_len) buf[curr++] = ' ';
+
+  return buf_len;
+}
+
+/* a quarter-long block going back and forth, for indeterminate threads */
+size_t cprogress_writebouncingbar(char *buf, size_t buf_len, char fill_char, uint32_t step) {
+  if (!buf_len) return 0;
+
+  size_t block_length = buf_len / 4? buf_len / 4: 1;
+  size_t travel = buf_len - block_length;
+  size_t offset = travel? step % (2 * travel): 0;
+  if (offset > travel) offset = 2 * travel - offset;
+
+  memset(buf, ' ', buf_len);
+  memset(buf + offset, fill_char, block_length);
+
+  return buf_len;
+}
+
+
+/* returns the length written, the line is zero terminated when shorter than buf_len */
+size_t cprogress_writelineinfo(cprogress_t *cprogress, char *buf, size_t buf_len, size_t console_width, const cprogress_lineinfo_t *lineinfo) {
+
+  char *line = buf;
+  if (!line || !buf_len) return 0;
+  if (console_width <= 1) {
+    *line = 0;
+    return 0;
+  }
+
+  /* a format_index that was never attached falls back to the default */
+  const cprogress_format_t *format = cprogress->formats[lineinfo->format_index < cprogress->formats_length? lineinfo->format_index: 0];
+
+  const char *title = lineinfo->title;
+  char strings[CPROGRESS_DISPLAYCHUNK_TYPE_LENGTH][CPROGRESS_CHUNKSTRING_MAXLEN];
+  cprogress_sprintchunks(format, strings, lineinfo);
 
   /* measure */
 
+  size_t display_widths[CPROGRESS_DISPLAYCHUNK_MAXLEN];
   size_t taken_display_width = 0;
-  cprogress_displaychunk_foreach(cprogress, displaychunk) {
+  cprogress_format_displaychunk_foreach(format, displaychunk) {
     if (!displaychunk->is_autospan) {
       size_t display_width = 0;
       switch (displaychunk->type) {
@@ -788,11 +2840,11 @@ void cprogress_writeline(cprogress_t *cprogress, char *buf, size_t buf_len, size
         case CPROGRESS_DISPLAYCHUNK_BAR:
           display_width = cprogress_measuredisplaychunk(displaychunk, NULL, CPROGRESS_UNDEF);
           break;
-        case CPROGRESS_DISPLAYCHUNK_PERCENTAGE:
-          display_width = cprogress_measuredisplaychunk(displaychunk, percentage_string, CPROGRESS_UNDEF);
+        default: /* computed text */
+          display_width = cprogress_measuredisplaychunk(displaychunk, strings[displaychunk->type], CPROGRESS_UNDEF);
           break;
       }
-      displaychunk->display_width = display_width;
+      display_widths[displaychunk - format->displaychunks] = display_width;
       taken_display_width += display_width;
     }
   }
@@ -805,10 +2857,10 @@ void cprogress_writeline(cprogress_t *cprogress, char *buf, size_t buf_len, size
 
   char *ptr = line;
   size_t avail_length = buf_len;
-  cprogress_displaychunk_foreach(cprogress, displaychunk) {
+  cprogress_format_displaychunk_foreach(format, displaychunk) {
     if (avail_length <= 0) break;
 
-    size_t display_width = displaychunk->is_autospan? autospan_width: displaychunk->display_width;
+    size_t display_width = displaychunk->is_autospan? autospan_width: display_widths[displaychunk - format->displaychunks];
     if (display_width == CPROGRESS_UNDEF) {} /* well, we have no idea */
     /* TODO error message */
 
@@ -821,16 +2873,716 @@ void cprogress_writeline(cprogress_t *cprogress, char *buf, size_t buf_len, size
         print_length = cprogress_writeliteral(ptr, avail_length, title, display_width);
         break;
       case CPROGRESS_DISPLAYCHUNK_BAR:
-        print_length = cprogress_writeprogressbar(ptr, display_width, displaychunk->fill_char, percentage);
+        if (lineinfo->is_indeterminate)
+          print_length = cprogress_writebouncingbar(ptr, display_width < avail_length? display_width: avail_length,
+            displaychunk->fill_char, lineinfo->spinner_index);
+        else
+          print_length = cprogress_writeprogressbar(ptr, display_width < avail_length? display_width: avail_length,
+            displaychunk->fill_char, lineinfo->percentage);
         break;
-      case CPROGRESS_DISPLAYCHUNK_PERCENTAGE:
-        print_length = cprogress_writeliteral(ptr, avail_length, percentage_string, display_width);
+      default: /* computed text */
+        print_length = cprogress_writeliteral(ptr, avail_length, strings[displaychunk->type], display_width);
         break;
     }
 
     ptr += print_length;
     avail_length -= print_length;
   }
+
+  if (avail_length) *ptr = 0;
+  return ptr - line;
+}
+
+size_t cprogress_writeline(cprogress_t *cprogress, char *buf, size_t buf_len, size_t console_width, const char *title, float percentage) {
+  cprogress_lineinfo_t lineinfo = cprogress_lineinfo_make(title, percentage);
+  return cprogress_writelineinfo(cprogress, buf, buf_len, console_width, &lineinfo);
+}
+
+
+/*----------------------------------------------------------------------------
+| stats
+----------------------------------------------------------------------------*/
+
+/* frame times are counted in log-linear buckets as in HDR histograms */
+size_t cprogress_stats_bucket(uint64_t ns) {
+  if (ns >> CPROGRESS_STATS_MAXBITS) ns = (1ULL << CPROGRESS_STATS_MAXBITS) - 1;
+  int msb = 63 - __builtin_clzll(ns | 1);
+  int shift = msb > CPROGRESS_STATS_SUBBUCKET_BITS? msb - CPROGRESS_STATS_SUBBUCKET_BITS: 0;
+  return ((size_t) shift << CPROGRESS_STATS_SUBBUCKET_BITS) + (ns >> shift);
+}
+
+/* the most ns a bucket holds */
+uint64_t cprogress_stats_bucketmax(size_t bucket) {
+  size_t shift = bucket >> (CPROGRESS_STATS_SUBBUCKET_BITS + 1)? (bucket >> CPROGRESS_STATS_SUBBUCKET_BITS) - 1: 0;
+  return ((uint64_t) (bucket - (shift << CPROGRESS_STATS_SUBBUCKET_BITS) + 1) << shift) - 1;
+}
+
+/* [begin] and [end] of a frame, from CPROGRESS_FRAME_CLOCK */
+void cprogress_stats_recordframe(cprogress_t *cprogress, uint64_t begin, uint64_t end) {
+  cprogress_stats_t *stats = &cprogress->stats;
+  uint64_t ns = end - begin;
+  uint64_t interval = cprogress->frame_interval_ns;
+
+  if (!stats->frames_rendered) {
+    cprogress->stats_firstframe_ns = begin;
+  } else if (interval && begin - cprogress->stats_lastframe_ns >= 2 * interval) {
+    stats->frames_skipped += (begin - cprogress->stats_lastframe_ns) / interval - 1;
+  }
+  cprogress->stats_lastframe_ns = begin;
+  if (interval && ns > interval) ++stats->deadlines_missed;
+
+  ++stats->frames_rendered;
+  stats->render_ns += ns;
+  stats->elapsed_ns = end - cprogress->stats_firstframe_ns;
+  if (ns > stats->render_max_ns) stats->render_max_ns = ns;
+  ++cprogress->stats_histogram[cprogress_stats_bucket(ns)];
+}
+
+/* the frame interval deadlines are checked against, zero or less to stop checking */
+void cprogress_setframerate(cprogress_t *cprogress, int fps) {
+  if (!cprogress) return;
+
+  cprogress->frame_interval_ns = fps > 0? 1000000000ULL / fps: 0;
+}
+
+/* call it on the rendering thread, percentiles are the upper bound of their bucket */
+void cprogress_stats(const cprogress_t *cprogress, cprogress_stats_t *stats) {
+  if (!cprogress || !stats) return;
+
+  *stats = cprogress->stats;
+  if (!stats->frames_rendered) return;
+
+  static const double quantiles[4] = { 0.5, 0.9, 0.99, 0.999 };
+  uint64_t *percentiles[4] = { &stats->render_p50_ns, &stats->render_p90_ns, &stats->render_p99_ns, &stats->render_p999_ns };
+  uint64_t frames = stats->frames_rendered, seen = 0;
+  size_t q = 0;
+  for (size_t bucket = 0; bucket < CPROGRESS_STATS_HISTOGRAM_LENGTH && q < 4; ++bucket) {
+    seen += cprogress->stats_histogram[bucket];
+    /* nearest rank, i.e. the first frame at or past the quantile */
+    while (q < 4 && seen >= quantiles[q] * frames) {
+      uint64_t ns = cprogress_stats_bucketmax(bucket);
+      *percentiles[q++] = ns < stats->render_max_ns? ns: stats->render_max_ns;
+    }
+  }
+}
+
+
+/*----------------------------------------------------------------------------
+| trace
+----------------------------------------------------------------------------*/
+
+/* allocated once, call it before any slot starts; records past [records_length] are dropped */
+cprogress_error_t cprogress_enabletrace(cprogress_t *cprogress, size_t records_length) {
+  if (!cprogress || !records_length || cprogress->trace) return CPROGRESS_ERROR_INVAL;
+
+  cprogress_trace_t *trace = (cprogress_trace_t *) cprogress_allocator_alloc(&cprogress->allocator,
+    sizeof(cprogress_trace_t) + records_length * sizeof(cprogress_tracerecord_t), CPROGRESS_ARENA_ALIGN);
+  if (!trace) return CPROGRESS_ERROR_INTERNAL;
+  trace->records_length = records_length;
+
+  /* segments grown later take it from the instance */
+  cprogress->trace = trace;
+  for (size_t k = 0; k < CPROGRESS_THREADINFO_SEGMENT_MAXLEN; ++k) {
+    cprogress_threadinfo_t *threadinfos = cprogress->threadinfo_segments[k];
+    if (!threadinfos) continue;
+    for (size_t i = 0; i < cprogress_threadinfo_segmentlength(cprogress, k); ++i) threadinfos[i].trace = trace;
+  }
+  return CPROGRESS_ERROR_OK;
+}
+
+/* lock-free from any thread: a record is claimed with one fetch and add, never waits */
+void cprogress_pushtrace(cprogress_trace_t *trace, cprogress_trace_type_t type, int thread_index, uint64_t ns,
+  float percentage, const char *title) {
+  uint64_t index = __atomic_fetch_add(&trace->length, 1, __ATOMIC_RELAXED);
+  if (index >= trace->records_length) return;
+
+  cprogress_tracerecord_t *record = &trace->records[index];
+  record->type = type;
+  record->thread_index = thread_index;
+  record->percentage = percentage;
+  record->ns = ns;
+  size_t title_length = title? strnlen(title, CPROGRESS_TITLE_MAXLEN - 1): 0;
+  if (title_length) memcpy(record->title, title, title_length);
+  record->title[title_length] = 0;
+  __atomic_store_n(&record->is_ready, 1, __ATOMIC_RELEASE);
+}
+
+/* trace writer: stdio may allocate, so it is gathered on the stack and handed to write(2) */
+typedef struct {
+  int fd;
+  int is_failed;
+  size_t used;
+  char buf[CPROGRESS_TRACEBUFFER_LENGTH];
+} cprogress_tracewriter_t;
+
+void cprogress_tracewriter_flush(cprogress_tracewriter_t *writer) {
+  size_t offset = 0;
+  while (offset < writer->used) {
+    ssize_t written = write(writer->fd, writer->buf + offset, writer->used - offset);
+    if (written < 0 && errno == EINTR) continue;
+    if (written <= 0) break;
+    offset += written;
+  }
+  if (offset < writer->used) writer->is_failed = 1;
+  writer->used = 0;
+}
+
+void cprogress_tracewriter_printf(cprogress_tracewriter_t *writer, const char *fmt, ...) {
+  for (int retry = 0; retry < 2; ++retry) {
+    size_t room = CPROGRESS_TRACEBUFFER_LENGTH - writer->used;
+    va_list args;
+    va_start(args, fmt);
+    int length = vsnprintf(writer->buf + writer->used, room, fmt, args);
+    va_end(args);
+    if (length < 0 || length >= CPROGRESS_TRACEBUFFER_LENGTH) {
+      writer->is_failed = 1;
+      return;
+    }
+    if (length < room) {
+      writer->used += length;
+      return;
+    }
+    cprogress_tracewriter_flush(writer);
+  }
+}
+
+void cprogress_tracewriter_jsonstring(cprogress_tracewriter_t *writer, const char *str) {
+  cprogress_tracewriter_printf(writer, "\"");
+  for (; *str; ++str) {
+    unsigned char ch = *str;
+    if (ch == '"' || ch == '\\') cprogress_tracewriter_printf(writer, "\\%c", ch);
+    else if (ch < 0x20) cprogress_tracewriter_printf(writer, "\\u%04x", ch);
+    else cprogress_tracewriter_printf(writer, "%c", ch);
+  }
+  cprogress_tracewriter_printf(writer, "\"");
+}
+
+/*
+  Chrome trace event format, for chrome://tracing or ui.perfetto.dev: a track per slot, with a
+  slice per title from start to finish, and progress as a counter; written with write(2) only
+*/
+cprogress_error_t cprogress_writetrace_fd(const cprogress_t *cprogress, int fd) {
+  if (!cprogress || !cprogress->trace || fd < 0) return CPROGRESS_ERROR_INVAL;
+
+  cprogress_tracewriter_t writer = { .fd = fd };
+  const cprogress_trace_t *trace = cprogress->trace;
+  uint64_t length = __atomic_load_n(&trace->length, __ATOMIC_RELAXED);
+  uint64_t dropped_count = length > trace->records_length? length - trace->records_length: 0;
+  if (dropped_count) length = trace->records_length;
+
+  /* clocks are read before records are claimed, so records are not quite in time order */
+  uint64_t begin_ns = UINT64_MAX;
+  for (uint64_t i = 0; i < length; ++i) {
+    const cprogress_tracerecord_t *record = &trace->records[i];
+    if (__atomic_load_n(&record->is_ready, __ATOMIC_ACQUIRE) && record->ns < begin_ns) begin_ns = record->ns;
+  }
+
+  cprogress_tracewriter_printf(&writer, "{\"traceEvents\": [\n");
+  int is_first = 1;
+  for (uint64_t i = 0; i < length; ++i) {
+    const cprogress_tracerecord_t *record = &trace->records[i];
+    if (!__atomic_load_n(&record->is_ready, __ATOMIC_ACQUIRE)) continue;
+
+    double ts = (record->ns > begin_ns? record->ns - begin_ns: 0) / 1e3; /* one that became ready since may be earlier */
+    int tid = record->thread_index;
+    const char *separator = is_first? "": ",\n";
+    is_first = 0;
+    switch (record->type) {
+    case CPROGRESS_TRACE_START:
+      cprogress_tracewriter_printf(&writer, "%s{\"ph\": \"M\", \"name\": \"thread_name\", \"pid\": 1, \"tid\": %d, "
+        "\"args\": {\"name\": \"slot %d\"}},\n", separator, tid, tid);
+      cprogress_tracewriter_printf(&writer, "{\"ph\": \"B\", \"name\": \"slot %d\", \"ts\": %.3f, \"pid\": 1, \"tid\": %d},\n", tid, ts, tid);
+      cprogress_tracewriter_printf(&writer, "{\"ph\": \"C\", \"name\": \"slot %d\", \"ts\": %.3f, \"pid\": 1, \"tid\": %d, "
+        "\"args\": {\"percentage\": 0}}", tid, ts, tid);
+      break;
+    case CPROGRESS_TRACE_TITLE:
+      /* a new title is a new slice */
+      cprogress_tracewriter_printf(&writer, "%s{\"ph\": \"E\", \"ts\": %.3f, \"pid\": 1, \"tid\": %d},\n", separator, ts, tid);
+      cprogress_tracewriter_printf(&writer, "{\"ph\": \"B\", \"name\": ");
+      cprogress_tracewriter_jsonstring(&writer, record->title);
+      cprogress_tracewriter_printf(&writer, ", \"ts\": %.3f, \"pid\": 1, \"tid\": %d}", ts, tid);
+      break;
+    case CPROGRESS_TRACE_PROGRESS:
+      cprogress_tracewriter_printf(&writer, "%s{\"ph\": \"C\", \"name\": \"slot %d\", \"ts\": %.3f, \"pid\": 1, \"tid\": %d, "
+        "\"args\": {\"percentage\": %.2f}}", separator, tid, ts, tid, record->percentage);
+      break;
+    case CPROGRESS_TRACE_FINISH:
+      cprogress_tracewriter_printf(&writer, "%s{\"ph\": \"C\", \"name\": \"slot %d\", \"ts\": %.3f, \"pid\": 1, \"tid\": %d, "
+        "\"args\": {\"percentage\": %.2f}},\n", separator, tid, ts, tid, record->percentage);
+      cprogress_tracewriter_printf(&writer, "{\"ph\": \"E\", \"ts\": %.3f, \"pid\": 1, \"tid\": %d}", ts, tid);
+      break;
+    }
+  }
+  cprogress_tracewriter_printf(&writer, "\n], \"displayTimeUnit\": \"ms\", \"otherData\": {\"dropped\": %llu}}\n",
+    (unsigned long long) dropped_count);
+  cprogress_tracewriter_flush(&writer);
+
+  return writer.is_failed? CPROGRESS_ERROR_INTERNAL: CPROGRESS_ERROR_OK;
+}
+
+cprogress_error_t cprogress_writetrace(const cprogress_t *cprogress, const char *path) {
+  if (!cprogress || !cprogress->trace || !path) return CPROGRESS_ERROR_INVAL;
+
+  int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd < 0) return CPROGRESS_ERROR_INTERNAL;
+  cprogress_error_t error = cprogress_writetrace_fd(cprogress, fd);
+  if (close(fd) && !error) error = CPROGRESS_ERROR_INTERNAL;
+  return error;
+}
+
+
+/*----------------------------------------------------------------------------
+| export
+----------------------------------------------------------------------------*/
+
+/*
+  periodically by cprogress_render(...), every [interval_ms] of frame time, or only by
+  cprogress_writeexport(...) when it is zero; JSON Lines are appended to [path], Prometheus
+  is written to [path].tmp then renamed over [path]
+*/
+cprogress_error_t cprogress_enableexport(cprogress_t *cprogress, cprogress_export_type_t type, const char *path, int interval_ms) {
+  if (!cprogress || cprogress->export_type || !path || interval_ms < 0) return CPROGRESS_ERROR_INVAL;
+  if (type != CPROGRESS_EXPORT_JSONLINES && type != CPROGRESS_EXPORT_PROMETHEUS) return CPROGRESS_ERROR_INVAL;
+  if (strlen(path) >= CPROGRESS_EXPORTPATH_MAXLEN) return CPROGRESS_ERROR_INVAL;
+
+  int fd = -1;
+  if (type == CPROGRESS_EXPORT_JSONLINES) {
+    fd = open(path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0) return CPROGRESS_ERROR_INTERNAL;
+  }
+  char *buf = (char *) cprogress_allocator_alloc(&cprogress->allocator, CPROGRESS_EXPORTBUFFER_LENGTH, 1);
+  if (!buf) {
+    if (fd >= 0) close(fd);
+    return CPROGRESS_ERROR_INTERNAL;
+  }
+
+  cprogress->export_type = type;
+  strcpy(cprogress->export_path, path);
+  cprogress->export_fd = fd;
+  cprogress->export_interval_ns = interval_ms * 1000000ULL;
+  cprogress->export_buf = buf;
+  cprogress->export_buf_used = 0;
+  return CPROGRESS_ERROR_OK;
+}
+
+/* written out as a whole, so a reader never sees a line cut unless the disk is full */
+int cprogress_export_flush(cprogress_t *cprogress) {
+  size_t offset = 0;
+  while (offset < cprogress->export_buf_used) {
+    ssize_t written = write(cprogress->export_fd, cprogress->export_buf + offset, cprogress->export_buf_used - offset);
+    if (written < 0 && errno == EINTR) continue;
+    if (written <= 0) break;
+    offset += written;
+  }
+  int is_failed = offset < cprogress->export_buf_used;
+  cprogress->export_buf_used = 0;
+  return is_failed;
+}
+
+/* a whole record at a time, records end with a newline and the buffer is flushed in between */
+void cprogress_export_printf(cprogress_t *cprogress, const char *fmt, ...) {
+  for (int retry = 0; retry < 2; ++retry) {
+    size_t room = CPROGRESS_EXPORTBUFFER_LENGTH - cprogress->export_buf_used;
+    va_list args;
+    va_start(args, fmt);
+    int length = vsnprintf(cprogress->export_buf + cprogress->export_buf_used, room, fmt, args);
+    va_end(args);
+    if (length < 0) return;
+    if (length < room) {
+      cprogress->export_buf_used += length;
+      return;
+    }
+    cprogress_export_flush(cprogress);
+  }
+}
+
+/* into [buf] of at least CPROGRESS_TITLE_MAXLEN * 6 bytes, as a JSON string or a Prometheus label value */
+void cprogress_export_escape(char *buf, const char *str, int is_json) {
+  static const char hex[] = "0123456789abcdef";
+  for (; *str; ++str) {
+    unsigned char ch = *str;
+    if (ch == '"' || ch == '\\') {
+      *buf++ = '\\';
+      *buf++ = ch;
+    } else if (ch == '\n') {
+      *buf++ = '\\';
+      *buf++ = 'n';
+    } else if (ch < 0x20 && is_json) {
+      memcpy(buf, "\\u00", 4);
+      buf[4] = hex[ch >> 4];
+      buf[5] = hex[ch & 15];
+      buf += 6;
+    } else {
+      *buf++ = ch;
+    }
+  }
+  *buf = 0;
+}
+
+/* with the same consistent snapshot and sampling as a line on screen, the updaters are never waited for */
+cprogress_slotstate_t cprogress_export_sample(cprogress_t *cprogress, cprogress_threadinfo_t *threadinfo,
+  cprogress_threadsnapshot_t *snapshot, cprogress_lineinfo_t *lineinfo) {
+  cprogress_threadinfo_snapshot(threadinfo, snapshot);
+  if (!snapshot->start_count) return CPROGRESS_SLOTSTATE_IDLE;
+
+  cprogress_threadinfo_sample(cprogress, threadinfo, snapshot, lineinfo);
+  if (snapshot->is_running) return CPROGRESS_SLOTSTATE_RUNNING;
+  return snapshot->percentage >= 100? CPROGRESS_SLOTSTATE_FINISHED: CPROGRESS_SLOTSTATE_ABORTED;
+}
+
+static const char *cprogress_slotstate_names[] = { "idle", "running", "finished", "aborted" };
+
+/* running slots, and stopped ones once, as they were last */
+void cprogress_export_jsonlines(cprogress_t *cprogress, double time) {
+  char title[CPROGRESS_TITLE_MAXLEN * 6];
+  cprogress_threadinfo_foreach(cprogress, threadinfo) {
+    cprogress_threadsnapshot_t snapshot;
+    cprogress_lineinfo_t lineinfo;
+    cprogress_slotstate_t state = cprogress_export_sample(cprogress, threadinfo, &snapshot, &lineinfo);
+    if (state == CPROGRESS_SLOTSTATE_IDLE) continue;
+    if (state != CPROGRESS_SLOTSTATE_RUNNING) {
+      if (threadinfo->exported_stop_count == snapshot.stop_count) continue;
+      threadinfo->exported_stop_count = snapshot.stop_count;
+    }
+
+    char parent[16] = "null", rate[32] = "null", eta[32] = "null";
+    uint32_t parent_index = __atomic_load_n(&threadinfo->parent, __ATOMIC_RELAXED);
+    if (parent_index) snprintf(parent, sizeof(parent), "%u", parent_index - 1);
+    if (lineinfo.rate >= 0) snprintf(rate, sizeof(rate), "%.3f", lineinfo.rate);
+    if (lineinfo.eta_ns >= 0) snprintf(eta, sizeof(eta), "%.3f", lineinfo.eta_ns / 1e9);
+    cprogress_export_escape(title, snapshot.title, 1);
+    cprogress_export_printf(cprogress, "{\"time\": %.3f, \"export\": %llu, \"slot\": %d, \"parent\": %s, "
+      "\"title\": \"%s\", \"state\": \"%s\", \"percentage\": %.2f, \"done\": %llu, \"total\": %llu, "
+      "\"rate\": %s, \"elapsed_s\": %.3f, \"eta_s\": %s}\n",
+      time, (unsigned long long) cprogress->export_index, snapshot.thread_index, parent,
+      title, cprogress_slotstate_names[state], lineinfo.percentage,
+      (unsigned long long) lineinfo.done, (unsigned long long) lineinfo.total,
+      rate, lineinfo.elapsed_ns >= 0? lineinfo.elapsed_ns / 1e9: 0, eta);
+  }
+}
+
+/*
+  every slot that ever started, for node_exporter's textfile collector; a metric family has to
+  be in one piece, so slots are taken once with the first family and read back for the others
+*/
+void cprogress_export_prometheus(cprogress_t *cprogress, double time) {
+  char title[CPROGRESS_TITLE_MAXLEN * 6];
+  cprogress_export_printf(cprogress, "# HELP cprogress_slot_info Slot title, parent and state, always 1.\n"
+    "# TYPE cprogress_slot_info gauge\n");
+  cprogress_threadinfo_foreach(cprogress, threadinfo) {
+    cprogress_threadsnapshot_t snapshot;
+    cprogress_lineinfo_t lineinfo;
+    cprogress_slotstate_t state = cprogress_export_sample(cprogress, threadinfo, &snapshot, &lineinfo);
+    threadinfo->export_state = state;
+    if (state == CPROGRESS_SLOTSTATE_IDLE) continue;
+
+    threadinfo->export_percentage = lineinfo.percentage;
+    threadinfo->export_done = lineinfo.done;
+    threadinfo->export_total = lineinfo.total;
+    threadinfo->export_rate = lineinfo.rate;
+    threadinfo->export_elapsed_ns = lineinfo.elapsed_ns;
+    threadinfo->export_eta_ns = lineinfo.eta_ns;
+    char parent[16] = "";
+    uint32_t parent_index = __atomic_load_n(&threadinfo->parent, __ATOMIC_RELAXED);
+    if (parent_index) snprintf(parent, sizeof(parent), "%u", parent_index - 1);
+    cprogress_export_escape(title, snapshot.title, 0);
+    cprogress_export_printf(cprogress, "cprogress_slot_info{slot=\"%d\",parent=\"%s\",title=\"%s\",state=\"%s\"} 1\n",
+      snapshot.thread_index, parent, title, cprogress_slotstate_names[state]);
+  }
+
+#define _cprogress_export_family(name, help, condition, fmt, value) \
+  cprogress_export_printf(cprogress, "# HELP cprogress_" name " " help "\n# TYPE cprogress_" name " gauge\n"); \
+  cprogress_threadinfo_foreach(cprogress, threadinfo) { \
+    if (threadinfo->export_state != CPROGRESS_SLOTSTATE_IDLE && (condition)) \
+      cprogress_export_printf(cprogress, "cprogress_" name "{slot=\"%d\"} " fmt "\n", threadinfo->thread_index, value); \
+  }
+
+  _cprogress_export_family("running", "1 while the slot runs.", 1,
+    "%d", threadinfo->export_state == CPROGRESS_SLOTSTATE_RUNNING)
+  _cprogress_export_family("percentage", "Progress in percent, rolled up for a parent.", 1,
+    "%.2f", threadinfo->export_percentage)
+  _cprogress_export_family("done", "Items done, when updated with counts.", threadinfo->export_total || threadinfo->export_done,
+    "%llu", (unsigned long long) threadinfo->export_done)
+  _cprogress_export_family("total", "Items in total, when known.", threadinfo->export_total,
+    "%llu", (unsigned long long) threadinfo->export_total)
+  _cprogress_export_family("rate", "Per second, in done when counted or else in percent.", threadinfo->export_rate >= 0,
+    "%.3f", threadinfo->export_rate)
+  _cprogress_export_family("elapsed_seconds", "Since the slot started.", threadinfo->export_elapsed_ns >= 0,
+    "%.3f", threadinfo->export_elapsed_ns / 1e9)
+  _cprogress_export_family("eta_seconds", "Estimated time left.", threadinfo->export_eta_ns >= 0,
+    "%.3f", threadinfo->export_eta_ns / 1e9)
+#undef _cprogress_export_family
+
+  cprogress_export_printf(cprogress, "# HELP cprogress_export_timestamp_seconds When this was written.\n"
+    "# TYPE cprogress_export_timestamp_seconds gauge\ncprogress_export_timestamp_seconds %.3f\n", time);
+}
+
+/* at frame.now_ns, on the renderer thread */
+cprogress_error_t cprogress_exportframe(cprogress_t *cprogress) {
+  cprogress->export_lastns = cprogress->frame.now_ns;
+
+  /* dashboards want the wall clock */
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  double time = ts.tv_sec + ts.tv_nsec / 1e9;
+
+  char tmp_path[CPROGRESS_EXPORTPATH_MAXLEN + sizeof(".tmp")];
+  if (cprogress->export_type == CPROGRESS_EXPORT_PROMETHEUS) {
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", cprogress->export_path);
+    cprogress->export_fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (cprogress->export_fd < 0) return CPROGRESS_ERROR_INTERNAL;
+    cprogress_export_prometheus(cprogress, time);
+  } else {
+    cprogress_export_jsonlines(cprogress, time);
+  }
+  ++cprogress->export_index;
+
+  int is_failed = cprogress_export_flush(cprogress);
+  if (cprogress->export_type == CPROGRESS_EXPORT_PROMETHEUS) {
+    /* a scraper sees either the last file or this one, never half of it */
+    is_failed = close(cprogress->export_fd) || is_failed || rename(tmp_path, cprogress->export_path);
+    if (is_failed) unlink(tmp_path);
+    cprogress->export_fd = -1;
+  }
+  return is_failed? CPROGRESS_ERROR_INTERNAL: CPROGRESS_ERROR_OK;
+}
+
+/* exports right now, e.g. the final state before cprogress_destroy(...); on the thread that renders */
+cprogress_error_t cprogress_writeexport(cprogress_t *cprogress) {
+  if (!cprogress || !cprogress->export_type) return CPROGRESS_ERROR_INVAL;
+
+  cprogress->frame.now_ns = cprogress_getnanotime();
+  return cprogress_exportframe(cprogress);
+}
+
+
+/*----------------------------------------------------------------------------
+| record
+----------------------------------------------------------------------------*/
+
+#define _cprogress_zigzag(value) ((uint64_t) (value) << 1 ^ (uint64_t) ((int64_t) (value) >> 63))
+#define _cprogress_unzigzag(value) ((int64_t) ((value) >> 1) ^ -(int64_t) ((value) & 1))
+
+/* at most 10 bytes */
+size_t cprogress_putvarint(char *buf, uint64_t value) {
+  size_t length = 0;
+  while (value >= 0x80) {
+    buf[length++] = (char) (value | 0x80);
+    value >>= 7;
+  }
+  buf[length++] = (char) value;
+  return length;
+}
+
+/* zero when it runs past [end], e.g. a record cut short by a crash */
+int cprogress_getvarint(const char **cursor, const char *end, uint64_t *value) {
+  *value = 0;
+  for (int shift = 0; *cursor < end && shift < 64; shift += 7) {
+    unsigned char byte = *(*cursor)++;
+    *value |= (uint64_t) (byte & 0x7f) << shift;
+    if (!(byte & 0x80)) return 1;
+  }
+  return 0;
+}
+
+/* what a slot takes at most in the buffer, frame header and terminator included */
+#define CPROGRESS_RECORD_SLOT_MAXLEN (CPROGRESS_TITLE_MAXLEN + 12 * 10)
+
+#define cprogress_record_putvarint(cp, value) \
+  ((cp)->record_buf_used += cprogress_putvarint((cp)->record_buf + (cp)->record_buf_used, value))
+
+/* FNV-1a, titles are compared by it so that slots keep no copy */
+uint32_t cprogress_record_titlehash(const char *title) {
+  uint32_t hash = 2166136261u;
+  for (; *title; ++title) hash = (hash ^ (unsigned char) *title) * 16777619u;
+  return hash;
+}
+
+/*
+  appends to [path], which is truncated, from now on every cprogress_render(...) writes what
+  changed; formats attached so far are kept in the header to replay with, attach any before
+*/
+cprogress_error_t cprogress_enablerecord(cprogress_t *cprogress, const char *path) {
+  if (!cprogress || cprogress->record_buf || !path || !cprogress->formats_length) return CPROGRESS_ERROR_INVAL;
+  for (size_t i = 0; i < cprogress->formats_length; ++i) {
+    cprogress_format_displaychunk_foreach(cprogress->formats[i], displaychunk) {
+      if (displaychunk->type == CPROGRESS_DISPLAYCHUNK_LITERAL &&
+        displaychunk->literal_length > CPROGRESS_RECORDBUFFER_LENGTH - CPROGRESS_RECORD_SLOT_MAXLEN) return CPROGRESS_ERROR_INVAL;
+    }
+  }
+
+  int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd < 0) return CPROGRESS_ERROR_INTERNAL;
+  char *buf = (char *) cprogress_allocator_alloc(&cprogress->allocator, CPROGRESS_RECORDBUFFER_LENGTH, 1);
+  if (!buf) {
+    close(fd);
+    return CPROGRESS_ERROR_INTERNAL;
+  }
+  cprogress->record_fd = fd;
+  cprogress->record_buf = buf;
+  cprogress->record_buf_used = 0;
+
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  memcpy(buf, CPROGRESS_RECORD_MAGIC, sizeof(CPROGRESS_RECORD_MAGIC) - 1);
+  cprogress->record_buf_used = sizeof(CPROGRESS_RECORD_MAGIC) - 1;
+  cprogress_record_putvarint(cprogress, CPROGRESS_RECORD_STEPS);
+  cprogress_record_putvarint(cprogress, ts.tv_sec * 1000ULL + ts.tv_nsec / 1000000);
+
+  cprogress_record_putvarint(cprogress, cprogress->formats_length);
+  for (size_t i = 0; i < cprogress->formats_length; ++i) {
+    const cprogress_format_t *format = cprogress->formats[i];
+    cprogress_record_putvarint(cprogress, format->displaychunks_length - 1);
+    cprogress_format_displaychunk_foreach(format, displaychunk) {
+      size_t length = displaychunk->type == CPROGRESS_DISPLAYCHUNK_LITERAL? displaychunk->literal_length: 0;
+      if (CPROGRESS_RECORDBUFFER_LENGTH - cprogress->record_buf_used < CPROGRESS_RECORD_SLOT_MAXLEN + length)
+        cprogress_flushrecord(cprogress);
+      cprogress_record_putvarint(cprogress, displaychunk->type);
+      cprogress_record_putvarint(cprogress, displaychunk->span_width + 1);
+      cprogress_record_putvarint(cprogress, displaychunk->is_autospan);
+      if (displaychunk->type == CPROGRESS_DISPLAYCHUNK_LITERAL) {
+        cprogress_record_putvarint(cprogress, displaychunk->literal_length);
+        memcpy(cprogress->record_buf + cprogress->record_buf_used, displaychunk->literal, displaychunk->literal_length);
+        cprogress->record_buf_used += displaychunk->literal_length;
+      } else if (displaychunk->type == CPROGRESS_DISPLAYCHUNK_BAR) {
+        cprogress_record_putvarint(cprogress, (unsigned char) displaychunk->fill_char);
+      }
+    }
+  }
+
+  cprogress->record_lastns = cprogress->record_flushns = cprogress_getnanotime();
+  return cprogress_flushrecord(cprogress);
+}
+
+cprogress_error_t cprogress_flushrecord(cprogress_t *cprogress) {
+  if (!cprogress || !cprogress->record_buf) return CPROGRESS_ERROR_INVAL;
+
+  size_t offset = 0;
+  while (offset < cprogress->record_buf_used) {
+    ssize_t written = write(cprogress->record_fd, cprogress->record_buf + offset, cprogress->record_buf_used - offset);
+    if (written < 0 && errno == EINTR) continue;
+    if (written <= 0) break;
+    offset += written;
+  }
+  int is_failed = offset < cprogress->record_buf_used;
+  cprogress->record_buf_used = 0;
+  return is_failed? CPROGRESS_ERROR_INTERNAL: CPROGRESS_ERROR_OK;
+}
+
+/* fields of a slot that changed enough since it was last recorded */
+uint32_t cprogress_record_diff(cprogress_threadinfo_t *threadinfo, const cprogress_threadsnapshot_t *snapshot,
+  int32_t *step, uint32_t *titlehash) {
+  uint32_t fields = 0;
+  if (snapshot->start_count != threadinfo->recorded_start_count) {
+    fields |= CPROGRESS_RECORD_START;
+    threadinfo->recorded_start_count = snapshot->start_count;
+    threadinfo->recorded_is_running = 1;
+    threadinfo->recorded_titlehash = cprogress_record_titlehash("");
+    threadinfo->recorded_step = 0;
+    threadinfo->recorded_done = threadinfo->recorded_total = 0;
+    threadinfo->recorded_is_indeterminate = 0;
+    threadinfo->recorded_format_index = 0;
+  } else if (!threadinfo->recorded_is_running) {
+    return 0;
+  }
+  int is_stopping = !snapshot->is_running;
+
+  if (__atomic_load_n(&threadinfo->parent, __ATOMIC_RELAXED) != threadinfo->recorded_parent) fields |= CPROGRESS_RECORD_PARENT;
+  *titlehash = cprogress_record_titlehash(snapshot->title);
+  if (*titlehash != threadinfo->recorded_titlehash) fields |= CPROGRESS_RECORD_TITLE;
+  if (snapshot->is_indeterminate != threadinfo->recorded_is_indeterminate) fields |= CPROGRESS_RECORD_INDETERMINATE;
+  if (snapshot->format_index != threadinfo->recorded_format_index) fields |= CPROGRESS_RECORD_FORMAT;
+  if (is_stopping) fields |= CPROGRESS_RECORD_STOP;
+  /* a parent rolls up from its children on replay */
+  if (snapshot->is_parent) return fields;
+
+  uint64_t done = snapshot->done, total = snapshot->total;
+  if (total != threadinfo->recorded_total) fields |= CPROGRESS_RECORD_TOTAL;
+  if (total) {
+    *step = done >= total? CPROGRESS_RECORD_STEPS: done * CPROGRESS_RECORD_STEPS / total;
+    if (done != threadinfo->recorded_done && (*step != threadinfo->recorded_step || fields & CPROGRESS_RECORD_TOTAL || is_stopping))
+      fields |= CPROGRESS_RECORD_DONE;
+  } else {
+    *step = snapshot->percentage * CPROGRESS_RECORD_STEPS / 100;
+    if (*step != threadinfo->recorded_step) fields |= CPROGRESS_RECORD_STEP;
+    /* counts alone move by the same share of themselves */
+    if (done != threadinfo->recorded_done &&
+      (done - threadinfo->recorded_done > threadinfo->recorded_done / CPROGRESS_RECORD_STEPS || is_stopping))
+      fields |= CPROGRESS_RECORD_DONE;
+  }
+  return fields;
+}
+
+/* once per cprogress_render(...), reading slots the same way, nothing is allocated */
+void cprogress_recordframe(cprogress_t *cprogress) {
+  uint64_t now = cprogress->frame.now_ns;
+  int is_framebegun = 0;
+  int prev_index = CPROGRESS_UNDEF;
+
+  cprogress_threadinfo_foreach(cprogress, threadinfo) {
+    cprogress_threadsnapshot_t snapshot;
+    cprogress_threadinfo_snapshot(threadinfo, &snapshot);
+    if (!snapshot.start_count) continue;
+
+    int32_t step = 0;
+    uint32_t titlehash = 0;
+    uint32_t fields = cprogress_record_diff(threadinfo, &snapshot, &step, &titlehash);
+    if (!fields) continue;
+
+    if (CPROGRESS_RECORDBUFFER_LENGTH - cprogress->record_buf_used < CPROGRESS_RECORD_SLOT_MAXLEN)
+      cprogress_flushrecord(cprogress);
+    if (!is_framebegun) {
+      /* whole us, so that the rounding doesn't add up */
+      uint64_t dt_us = (now - cprogress->record_lastns) / 1000;
+      cprogress->record_lastns += dt_us * 1000;
+      cprogress_record_putvarint(cprogress, dt_us);
+      is_framebegun = 1;
+    }
+    cprogress_record_putvarint(cprogress, snapshot.thread_index - prev_index);
+    prev_index = snapshot.thread_index;
+    cprogress_record_putvarint(cprogress, fields);
+
+    if (fields & CPROGRESS_RECORD_TITLE) {
+      size_t length = strlen(snapshot.title);
+      cprogress_record_putvarint(cprogress, length);
+      memcpy(cprogress->record_buf + cprogress->record_buf_used, snapshot.title, length);
+      cprogress->record_buf_used += length;
+      threadinfo->recorded_titlehash = titlehash;
+    }
+    if (fields & CPROGRESS_RECORD_STEP) {
+      cprogress_record_putvarint(cprogress, _cprogress_zigzag((int64_t) step - threadinfo->recorded_step));
+    }
+    if (fields & (CPROGRESS_RECORD_STEP | CPROGRESS_RECORD_DONE)) threadinfo->recorded_step = step;
+    if (fields & CPROGRESS_RECORD_DONE) {
+      cprogress_record_putvarint(cprogress, _cprogress_zigzag((int64_t) (snapshot.done - threadinfo->recorded_done)));
+      threadinfo->recorded_done = snapshot.done;
+    }
+    if (fields & CPROGRESS_RECORD_TOTAL) {
+      cprogress_record_putvarint(cprogress, snapshot.total);
+      threadinfo->recorded_total = snapshot.total;
+    }
+    if (fields & CPROGRESS_RECORD_INDETERMINATE) {
+      cprogress_record_putvarint(cprogress, snapshot.is_indeterminate);
+      threadinfo->recorded_is_indeterminate = snapshot.is_indeterminate;
+    }
+    if (fields & CPROGRESS_RECORD_PARENT) {
+      uint32_t parent = __atomic_load_n(&threadinfo->parent, __ATOMIC_ACQUIRE);
+      cprogress_record_putvarint(cprogress, parent);
+      cprogress_record_putvarint(cprogress, parent? __atomic_load_n(&threadinfo->weight, __ATOMIC_RELAXED): 0);
+      threadinfo->recorded_parent = parent;
+    }
+    if (fields & CPROGRESS_RECORD_FORMAT) {
+      cprogress_record_putvarint(cprogress, snapshot.format_index);
+      threadinfo->recorded_format_index = snapshot.format_index;
+    }
+    if (fields & CPROGRESS_RECORD_STOP) threadinfo->recorded_is_running = 0;
+  }
+  if (is_framebegun) cprogress_record_putvarint(cprogress, 0);
+
+  if (now - cprogress->record_flushns >= CPROGRESS_RECORD_FLUSH_MS * 1000000ULL) {
+    cprogress->record_flushns = now;
+    cprogress_flushrecord(cprogress);
+  }
 }
 
 
@@ -838,46 +3590,71 @@ void cprogress_writeline(cprogress_t *cprogress, char *buf, size_t buf_len, size
 | view controller
 ----------------------------------------------------------------------------*/
 
+/* CPROGRESS_CONSOLE_FALLBACKWIDTH when stdout is not a terminal */
 int cprogress_getconsolewidth() {
   struct winsize w;
-  ioctl(STDOUT_FILENO, TIOCGWINSZ, &w);
-  return w.ws_col;
+  if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &w) == -1 || !w.ws_col) return CPROGRESS_CONSOLE_FALLBACKWIDTH;
+  return w.ws_col < CPROGRESS_CONSOLE_MAXWIDTH? w.ws_col: CPROGRESS_CONSOLE_MAXWIDTH;
 }
 
-#define _cprogress_printline_widthtolength(width) (width * 4 + 1)
+/* frame buffer: output is gathered and handed to write(2) once per frame, or whenever it fills up */
+void cprogress_flushframe(cprogress_t *cprogress) {
+  if (!cprogress->frame_buf_used) return;
 
-void cprogress_printline(cprogress_t *cprogress, const char *title, float percentage) {
-  /* TODO move to instance */
-  static int console_width = CPROGRESS_UNDEF;
-  static int keep_consolewidth_loopcount = 0;
-
-  static char *buf = NULL;
-  static size_t buf_len = 0;
-
-  if (console_width == CPROGRESS_UNDEF) {
-    console_width = cprogress_getconsolewidth();
-    buf = malloc(buf_len = _cprogress_printline_widthtolength(console_width));
-    if (!buf) {} /* TODO well i have no idea neither */
-  } else if (keep_consolewidth_loopcount >= CPROGRESS_CONSOLE_UPDATEWIDTH_LOOPCOUNT) {
-    keep_consolewidth_loopcount = 0;
-    int new_console_width = cprogress_getconsolewidth();
-    if (new_console_width != console_width) {
-      buf = realloc(buf, buf_len = _cprogress_printline_widthtolength(console_width));
-      if (!buf) {} /* TODO same as above */
-      console_width = new_console_width;
-    }
+  /* whatever the program printed through stdio goes first */
+  fflush(stdout);
+
+  int fd = fileno(stdout);
+  size_t offset = 0;
+  while (offset < cprogress->frame_buf_used) {
+    ssize_t written = write(fd, cprogress->frame_buf + offset, cprogress->frame_buf_used - offset);
+    ++cprogress->stats.write_calls;
+    if (written < 0 && errno == EINTR) continue;
+    if (written <= 0) break; /* nowhere to go, the rest of the frame is dropped */
+    offset += written;
+    cprogress->stats.bytes_written += written;
   }
+  cprogress->frame_buf_used = 0;
+}
 
-  /* actual draw */
+/* room for [length] more bytes, written out first if they don't fit */
+char *cprogress_reserveframe(cprogress_t *cprogress, size_t length) {
+  if (cprogress->frame_buf_len - cprogress->frame_buf_used < length) cprogress_flushframe(cprogress);
+  return cprogress->frame_buf + cprogress->frame_buf_used;
+}
 
-  memset(buf, 0, buf_len);
-  cprogress_writeline(cprogress, buf, buf_len, console_width, title, percentage);
-  printf("%s", buf);
-  fflush(stdout);
+void cprogress_printframe(cprogress_t *cprogress, const char *str, size_t length) {
+  memcpy(cprogress_reserveframe(cprogress, length), str, length);
+  cprogress->frame_buf_used += length;
+}
+
+#define cprogress_printframe_literal(cp, literal) cprogress_printframe(cp, literal, sizeof(literal) - 1)
+
+/* nothing is allocated here, the line is written right into the frame buffer in the arena */
+void cprogress_printlineinfo(cprogress_t *cprogress, const cprogress_lineinfo_t *lineinfo) {
+  if (!cprogress->console_width || cprogress->keep_consolewidth_loopcount >= CPROGRESS_CONSOLE_UPDATEWIDTH_LOOPCOUNT) {
+    cprogress->keep_consolewidth_loopcount = 0;
+    cprogress->console_width = cprogress->stats.console_width = cprogress_getconsolewidth();
+  }
+
+  char *buf = cprogress_reserveframe(cprogress, CPROGRESS_PRINTLINE_MAXLEN);
+  size_t buf_len = CPROGRESS_PRINTLINE_MAXLEN;
+  int console_width = cprogress->console_width;
+
+  /* actual draw, the writer tells the length so the buffer is never cleared */
+
+  size_t length = cprogress_writelineinfo(cprogress, buf, buf_len, console_width, lineinfo);
+  cprogress->frame_buf_used += length;
+  if (!cprogress->is_inframe) cprogress_flushframe(cprogress);
 
   /* misc */
 
-  ++keep_consolewidth_loopcount;
+  ++cprogress->keep_consolewidth_loopcount;
+}
+
+void cprogress_printline(cprogress_t *cprogress, const char *title, float percentage) {
+  cprogress_lineinfo_t lineinfo = cprogress_lineinfo_make(title, percentage);
+  cprogress_printlineinfo(cprogress, &lineinfo);
 }
 
 
@@ -885,6 +3662,9 @@ void cprogress_abort(cprogress_t *cprogress) {
   if (!cprogress) return;
 
   cprogress->is_running = 0;
+
+  if (!__atomic_exchange_n(&cprogress->is_finish_pushed, 1, __ATOMIC_ACQ_REL))
+    cprogress_pushevent(cprogress->eventqueue, CPROGRESS_EVENT_FINISH, CPROGRESS_UNDEF);
 }
 
 int cprogress_stillrunning(cprogress_t *cprogress) {
@@ -892,7 +3672,9 @@ int cprogress_stillrunning(cprogress_t *cprogress) {
 
   int is_all_finished = 1;
   cprogress_threadinfo_foreach(cprogress, threadinfo) {
-    if (threadinfo->is_running || threadinfo->is_just_stopped) {
+    cprogress_threadsnapshot_t snapshot;
+    cprogress_threadinfo_snapshot(threadinfo, &snapshot);
+    if (snapshot.is_running || snapshot.is_just_stopped) {
       is_all_finished = 0;
       break;
     }
@@ -900,8 +3682,6 @@ int cprogress_stillrunning(cprogress_t *cprogress) {
 
   if (is_all_finished) cprogress_abort(cprogress);
 
-  if (!cprogress->is_running) cprogress_emitevent(cprogress, CPROGRESS_EVENT_FINISH, CPROGRESS_UNDEF);
-
   return cprogress->is_running;
 }
 
@@ -910,45 +3690,252 @@ void cprogress_waitfps(int fps) {
 }
 
 /* only do clear and redraw in current line */
-void cprogress_renderline(cprogress_t *cprogress, const char *title, float percentage) {
+void cprogress_renderline(cprogress_t *cprogress, const cprogress_lineinfo_t *lineinfo) {
   if (!cprogress) return;
 
-  printf("\x1b[1G\x1b[1K"); /* move to column 1, clear the entire line */
-  cprogress_printline(cprogress, title, percentage);
+  cprogress_printframe_literal(cprogress, "\x1b[1G\x1b[1K"); /* move to column 1, clear the entire line */
+  cprogress_printlineinfo(cprogress, lineinfo);
 }
 
-void cprogress_render(cprogress_t *cprogress) {
-  if (!cprogress) return;
+#define CPROGRESS_SAMPLED_DISPLAYCHUNK_TYPES ( \
+  1u << CPROGRESS_DISPLAYCHUNK_RATE | 1u << CPROGRESS_DISPLAYCHUNK_BYTERATE | \
+  1u << CPROGRESS_DISPLAYCHUNK_ETA | 1u << CPROGRESS_DISPLAYCHUNK_ELAPSED | \
+  1u << CPROGRESS_DISPLAYCHUNK_SPINNER)
+
+/* renderer side sampling, the only place where time is taken into account */
+void cprogress_threadinfo_sample(cprogress_t *cprogress, cprogress_threadinfo_t *threadinfo,
+  const cprogress_threadsnapshot_t *snapshot, cprogress_lineinfo_t *lineinfo) {
+  *lineinfo = (cprogress_lineinfo_t) {
+    .title = snapshot->title,
+    .percentage = snapshot->percentage,
+    .done = snapshot->is_parent? 0: snapshot->done,
+    .total = snapshot->is_parent? 0: snapshot->total,
+    .rate = CPROGRESS_UNDEF,
+    .elapsed_ns = CPROGRESS_UNDEF,
+    .eta_ns = CPROGRESS_UNDEF,
+    .idle_ns = CPROGRESS_UNDEF,
+    .is_indeterminate = snapshot->is_indeterminate,
+    .format_index = snapshot->format_index
+  };
+  if (threadinfo->trace && snapshot->is_running && snapshot->percentage != threadinfo->traced_percentage) {
+    threadinfo->traced_percentage = snapshot->percentage;
+    cprogress_pushtrace(threadinfo->trace, CPROGRESS_TRACE_PROGRESS, cprogress_threadinfo_getindex(threadinfo),
+      cprogress->frame.now_ns, snapshot->percentage, NULL);
+  }
+  if (!(cprogress->displaychunk_types & CPROGRESS_SAMPLED_DISPLAYCHUNK_TYPES) && !snapshot->is_indeterminate &&
+    !cprogress->export_type) return;
+
+  uint64_t now = cprogress->frame.now_ns;
+  double value = lineinfo->total || snapshot->is_indeterminate? (double) lineinfo->done: lineinfo->percentage;
+
+  if (threadinfo->rendered_start_count != snapshot->start_count) {
+    /* (re)started since last frame */
+    threadinfo->rendered_start_count = snapshot->start_count;
+    threadinfo->start_ns = threadinfo->update_ns = threadinfo->sample_ns = now;
+    threadinfo->stop_ns = 0;
+    threadinfo->sample_value = value;
+    threadinfo->rate = CPROGRESS_UNDEF;
+  } else if (snapshot->is_running && now > threadinfo->sample_ns) {
+    double dt = (now - threadinfo->sample_ns) / 1e9;
+    double instant_rate = (value - threadinfo->sample_value) / dt;
+    if (threadinfo->rate < 0) {
+      threadinfo->rate = instant_rate;
+    } else {
+      /* exponential moving average that weighs by time, not by frame */
+      double alpha = dt / (CPROGRESS_RATE_TAU_MS / 1e3 + dt);
+      threadinfo->rate += alpha * (instant_rate - threadinfo->rate);
+    }
+    if (value != threadinfo->sample_value) threadinfo->update_ns = now;
+    threadinfo->sample_ns = now;
+    threadinfo->sample_value = value;
+  }
 
-  /* count how many threads are alive */
-  int alive_thread_count = 0;
+  if (threadinfo->rendered_tick_count != snapshot->tick_count) {
+    threadinfo->rendered_tick_count = snapshot->tick_count;
+    threadinfo->update_ns = now;
+  }
+  /* the animation goes on with the frame counter only while the thread is alive */
+  if (snapshot->is_running && now - threadinfo->update_ns < CPROGRESS_SPINNER_STALL_MS * 1000000ULL)
+    threadinfo->spinner_index = cprogress->frame.index / CPROGRESS_SPINNER_FRAMES_PER_GLYPH;
+  lineinfo->spinner_index = threadinfo->spinner_index;
+
+  if (!snapshot->is_running && !threadinfo->stop_ns) threadinfo->stop_ns = now;
+  uint64_t end_ns = snapshot->is_running? now: threadinfo->stop_ns;
+
+  lineinfo->rate = threadinfo->rate;
+  lineinfo->elapsed_ns = end_ns - threadinfo->start_ns;
+  lineinfo->idle_ns = end_ns - threadinfo->update_ns;
+  if (!snapshot->is_running) {
+    lineinfo->eta_ns = 0;
+  } else if (threadinfo->rate > 0 && !snapshot->is_indeterminate) {
+    double left = lineinfo->total? (double) (lineinfo->total - lineinfo->done): 100 - lineinfo->percentage;
+    lineinfo->eta_ns = left / threadinfo->rate * 1e9;
+  }
+}
+
+#define CPROGRESS_TREE_INDENT 2
+
+/* draws a thread at its depth of the tree, with a mark telling whether it's folded */
+void cprogress_renderthread(cprogress_t *cprogress, cprogress_threadinfo_t *threadinfo,
+  const cprogress_threadsnapshot_t *snapshot, int depth, int is_collapsed) {
+  cprogress_lineinfo_t lineinfo;
+  cprogress_threadinfo_sample(cprogress, threadinfo, snapshot, &lineinfo);
+
+  if (!depth && !snapshot->is_parent) {
+    cprogress_renderline(cprogress, &lineinfo);
+    cprogress_printframe_literal(cprogress, "\n"); /* move to next line */
+    return;
+  }
+
+  char title[CPROGRESS_TITLE_MAXLEN * 2];
+  size_t indent = depth * CPROGRESS_TREE_INDENT;
+  if (indent > CPROGRESS_TITLE_MAXLEN - 2) indent = CPROGRESS_TITLE_MAXLEN - 2;
+  memset(title, ' ', indent);
+  title[indent] = snapshot->is_parent? (is_collapsed? '+': '-'): ' ';
+  title[indent + 1] = ' ';
+  strcpy(title + indent + 2, snapshot->title);
+
+  lineinfo.title = title;
+  cprogress_renderline(cprogress, &lineinfo);
+  cprogress_printframe_literal(cprogress, "\n"); /* move to next line */
+}
+
+/* renderer side of the hierarchy: link children in thread_index order, once per frame */
+void cprogress_rendertree_link(cprogress_t *cprogress) {
   cprogress_threadinfo_foreach(cprogress, threadinfo) {
-    if (threadinfo->is_running)
-      ++alive_thread_count;
+    threadinfo->render_firstchild = threadinfo->render_lastchild = threadinfo->render_nextsibling = 0;
+  }
+
+  uint32_t lastroot = 0;
+  cprogress->render_firstroot = 0;
+  cprogress_threadinfo_foreach(cprogress, threadinfo) {
+    uint32_t self = cprogress_threadinfo_getindex(threadinfo) + 1;
+    uint32_t parent = __atomic_load_n(&threadinfo->parent, __ATOMIC_ACQUIRE);
+    cprogress_threadinfo_t *parent_threadinfo = parent? cprogress_threadinfo_at(cprogress, parent - 1): NULL;
+    if (!parent_threadinfo) parent = 0;
+    threadinfo->render_parent = parent;
+
+    uint32_t *firstchild = parent? &parent_threadinfo->render_firstchild: &cprogress->render_firstroot;
+    uint32_t *lastchild = parent? &parent_threadinfo->render_lastchild: &lastroot;
+    if (*lastchild) {
+      cprogress_getthreadinfo(cprogress, *lastchild - 1).render_nextsibling = self;
+    } else {
+      *firstchild = self;
+    }
+    *lastchild = self;
   }
+}
+
+/* depth first, skipping folded subtrees; returns how many lines are drawn */
+int cprogress_rendertree_running(cprogress_t *cprogress) {
+  int line_count = 0;
+  int depth = 0;
+  uint32_t node = cprogress->render_firstroot;
+  while (node) {
+    cprogress_threadinfo_t *threadinfo = &cprogress_getthreadinfo(cprogress, node - 1);
+    int is_collapsed = __atomic_load_n(&threadinfo->is_collapsed, __ATOMIC_RELAXED);
+
+    cprogress_threadsnapshot_t snapshot;
+    cprogress_threadinfo_snapshot(threadinfo, &snapshot);
+    if (snapshot.is_running) {
+      cprogress_renderthread(cprogress, threadinfo, &snapshot, depth, is_collapsed);
+      ++line_count;
+    }
+
+    if (threadinfo->render_firstchild && !is_collapsed) {
+      node = threadinfo->render_firstchild;
+      ++depth;
+      continue;
+    }
+
+    /* go up until there's a next sibling */
+    while (node && !cprogress_getthreadinfo(cprogress, node - 1).render_nextsibling) {
+      node = cprogress_getthreadinfo(cprogress, node - 1).render_parent;
+      --depth;
+    }
+    if (node) node = cprogress_getthreadinfo(cprogress, node - 1).render_nextsibling;
+  }
+  return line_count;
+}
+
+/* CPROGRESS_UNDEF when hidden in a folded subtree */
+int cprogress_rendertree_depth(cprogress_t *cprogress, cprogress_threadinfo_t *threadinfo) {
+  int depth = 0;
+  for (uint32_t parent = threadinfo->render_parent; parent; ++depth) {
+    cprogress_threadinfo_t *parent_threadinfo = &cprogress_getthreadinfo(cprogress, parent - 1);
+    if (__atomic_load_n(&parent_threadinfo->is_collapsed, __ATOMIC_RELAXED)) return CPROGRESS_UNDEF;
+    parent = parent_threadinfo->render_parent;
+  }
+  return depth;
+}
+
+/*
+  a frame at [now_ns] of CPROGRESS_FRAME_CLOCK instead of the time it is, e.g. to replay a record;
+  it is not counted in stats, nor exported or recorded, see cprogress_render(...)
+*/
+void cprogress_renderat(cprogress_t *cprogress, uint64_t now_ns) {
+  if (!cprogress) return;
+
+  cprogress->frame.now_ns = now_ns;
+  cprogress->is_inframe = 1;
+  cprogress_probe2(frame_begin, cprogress->frame.index, cprogress->frame.now_ns);
+
+  int has_hierarchy = __atomic_load_n(&cprogress->has_hierarchy, __ATOMIC_ACQUIRE);
+  if (has_hierarchy) cprogress_rendertree_link(cprogress);
 
   /* move to head for redraw */
-  if (cprogress->last_alive_thread_count)
-    printf("\x1b[%dA", cprogress->last_alive_thread_count);
+  if (cprogress->last_alive_thread_count) {
+    char move[32];
+    cprogress_printframe(cprogress, move, snprintf(move, sizeof(move), "\x1b[%dA", cprogress->last_alive_thread_count));
+  }
 
   cprogress_threadinfo_foreach(cprogress, threadinfo) {
-    if (threadinfo->is_just_stopped) {
-      threadinfo->is_just_stopped = 0;
-      cprogress_renderline(cprogress, threadinfo->title, threadinfo->percentage);
-      puts(""); /* move to next line */
-      /* TODO move to cprogress_stillrunning(...) */
-      cprogress_emitevent(cprogress, CPROGRESS_EVENT_THREADFINISH, cprogress_threadinfo_getindex(threadinfo));
+    cprogress_threadsnapshot_t snapshot;
+    cprogress_threadinfo_snapshot(threadinfo, &snapshot);
+    if (snapshot.is_just_stopped) {
+      threadinfo->rendered_stop_count = snapshot.stop_count;
+      int depth = has_hierarchy? cprogress_rendertree_depth(cprogress, threadinfo): 0;
+      if (depth != CPROGRESS_UNDEF) cprogress_renderthread(cprogress, threadinfo, &snapshot, depth, 0);
     }
   }
 
-  cprogress_threadinfo_foreach(cprogress, threadinfo) {
-    if (threadinfo->is_running) {
-      cprogress_renderline(cprogress, threadinfo->title, threadinfo->percentage);
-      puts(""); /* move to next line */
+  /* count alive threads while drawing, so the count always matches lines on screen */
+  int alive_thread_count = 0;
+  if (has_hierarchy) {
+    alive_thread_count = cprogress_rendertree_running(cprogress);
+  } else {
+    cprogress_threadinfo_foreach(cprogress, threadinfo) {
+      cprogress_threadsnapshot_t snapshot;
+      cprogress_threadinfo_snapshot(threadinfo, &snapshot);
+      if (snapshot.is_running) {
+        cprogress_renderthread(cprogress, threadinfo, &snapshot, 0, 0);
+        ++alive_thread_count;
+      }
     }
   }
 
   cprogress->last_alive_thread_count = alive_thread_count;
+  ++cprogress->frame.index;
+
+  /* the whole frame in as few write(2) as the frame buffer allows */
+  cprogress_flushframe(cprogress);
+  cprogress->is_inframe = 0;
+}
+
+void cprogress_render(cprogress_t *cprogress) {
+  if (!cprogress) return;
+
+  /* the only clock read of a frame, every time related chunk of every line uses it */
+  uint64_t now_ns = cprogress_getnanotime();
+  cprogress_renderat(cprogress, now_ns);
+  uint64_t end_ns = cprogress_getnanotime();
+  cprogress_stats_recordframe(cprogress, now_ns, end_ns);
+  cprogress_probe3(frame_end, cprogress->frame.index - 1, end_ns - now_ns, cprogress->last_alive_thread_count);
+
+  /* at their own cadence, after the frame is out and not counted in its stats */
+  if (cprogress->export_interval_ns && now_ns - cprogress->export_lastns >= cprogress->export_interval_ns)
+    cprogress_exportframe(cprogress);
+  if (cprogress->record_buf) cprogress_recordframe(cprogress);
 }
 
 void cprogress_rendersum(cprogress_t *cprogress, const char *title) {
@@ -957,23 +3944,32 @@ void cprogress_rendersum(cprogress_t *cprogress, const char *title) {
   int alive_thread_count = 0;
   float percentage = 0;
   cprogress_threadinfo_foreach(cprogress, threadinfo) {
-    if (threadinfo->is_running) {
-      percentage += threadinfo->percentage;
+    cprogress_threadsnapshot_t snapshot;
+    cprogress_threadinfo_snapshot(threadinfo, &snapshot);
+    if (snapshot.is_running) {
+      percentage += snapshot.percentage;
       ++alive_thread_count;
     }
   }
   percentage /= alive_thread_count;
 
-  cprogress_renderline(cprogress, title, percentage);
+  cprogress_lineinfo_t lineinfo = cprogress_lineinfo_make(title, percentage);
+  cprogress_renderline(cprogress, &lineinfo);
 }
 
 void cprogress_render_tillcomplete(cprogress_t *cprogress, int fps) {
   if (!cprogress) return;
 
+  cprogress_setframerate(cprogress, fps);
   while (cprogress_stillrunning(cprogress)) {
     cprogress_render(cprogress);
+    cprogress_dispatchevents(cprogress);
     cprogress_waitfps(fps);
   }
+
+  /* deliver whatever is left, including CPROGRESS_EVENT_FINISH */
+  cprogress_dispatchevents(cprogress);
+  if (cprogress->export_type) cprogress_writeexport(cprogress);
 }
 
 
@@ -984,52 +3980,282 @@ void cprogress_render_tillcomplete(cprogress_t *cprogress, int fps) {
 void cprogress_threadinfo_updatetitle(cprogress_threadinfo_t *threadinfo, const char *title) {
   if (!threadinfo || !threadinfo->is_running) return;
 
-  char *previous_title = threadinfo->title;
-  if (previous_title) free(previous_title);
+  cprogress_threadinfo_writebegin(threadinfo);
+  size_t length = title? strnlen(title, CPROGRESS_TITLE_MAXLEN - 1): 0;
+  if (length) memcpy(threadinfo->title, title, length);
+  threadinfo->title[length] = 0;
+  cprogress_threadinfo_writeend(threadinfo);
+  if (threadinfo->trace) cprogress_pushtrace(threadinfo->trace, CPROGRESS_TRACE_TITLE, cprogress_threadinfo_getindex(threadinfo),
+    cprogress_getnanotime(), threadinfo->percentage, threadinfo->title);
+}
 
-  threadinfo->title = cprogress_strdup(title);
+/* must be called between writebegin and writeend, returns non-zero when it reaches 100% */
+int cprogress_threadinfo_setpercentage(cprogress_threadinfo_t *threadinfo, float percentage) {
+  int is_stopped = 0;
+  if (percentage < 0) percentage = 0;
+  if (percentage >= 100) {
+    percentage = 100;
+    is_stopped = cprogress_threadinfo_markstopped(threadinfo);
+  }
+  threadinfo->percentage = percentage;
+  return is_stopped;
 }
 
 void cprogress_threadinfo_updatepercentage(cprogress_threadinfo_t *threadinfo, float percentage) {
   if (!threadinfo || !threadinfo->is_running) return;
 
-  if (percentage >= 100) {
-    percentage = 100;
-    cprogress_threadinfo_abort(threadinfo);
+  cprogress_threadinfo_writebegin(threadinfo);
+  int is_stopped = cprogress_threadinfo_setpercentage(threadinfo, percentage);
+  cprogress_threadinfo_writeend(threadinfo);
+  cprogress_probe4(thread_update, cprogress_threadinfo_getindex(threadinfo),
+    _cprogress_probe_percentage(threadinfo->percentage), threadinfo->done, threadinfo->total);
+
+  cprogress_threadinfo_rollup(threadinfo, threadinfo->percentage);
+  if (is_stopped) {
+    if (threadinfo->trace) cprogress_pushtrace(threadinfo->trace, CPROGRESS_TRACE_FINISH, cprogress_threadinfo_getindex(threadinfo),
+      cprogress_getnanotime(), threadinfo->percentage, NULL);
+    cprogress_pushevent(threadinfo->eventqueue, CPROGRESS_EVENT_THREADFINISH, cprogress_threadinfo_getindex(threadinfo));
   }
-  if (percentage < 0) percentage = 0;
-  threadinfo->percentage = percentage;
 }
 
 void cprogress_updatethread_title(cprogress_t *cprogress, int thread_index, const char *title) {
-  if (!cprogress || thread_index < 0 || thread_index >= cprogress->threadinfos_length) return;
+  if (!cprogress || thread_index < 0 || thread_index >= cprogress_getthreadinfos_length(cprogress)) return;
   cprogress_threadinfo_updatetitle(&cprogress_getthreadinfo(cprogress, thread_index), title);
 }
 
 void cprogress_updatethread_percentage(cprogress_t *cprogress, int thread_index, float percentage) {
-  if (!cprogress || thread_index < 0 || thread_index >= cprogress->threadinfos_length) return;
+  if (!cprogress || thread_index < 0 || thread_index >= cprogress_getthreadinfos_length(cprogress)) return;
   cprogress_threadinfo_updatepercentage(&cprogress_getthreadinfo(cprogress, thread_index), percentage);
 }
 
+void cprogress_threadinfo_updateprogress(cprogress_threadinfo_t *threadinfo, uint64_t done, uint64_t total) {
+  if (!threadinfo || !threadinfo->is_running) return;
+
+  cprogress_threadinfo_writebegin(threadinfo);
+  threadinfo->done = done;
+  threadinfo->total = total;
+  int is_stopped = total && cprogress_threadinfo_setpercentage(threadinfo, done >= total? 100: done * 100.0 / total);
+  cprogress_threadinfo_writeend(threadinfo);
+  cprogress_probe4(thread_update, cprogress_threadinfo_getindex(threadinfo),
+    _cprogress_probe_percentage(threadinfo->percentage), done, total);
+
+  cprogress_threadinfo_rollup(threadinfo, threadinfo->percentage);
+  if (is_stopped) {
+    if (threadinfo->trace) cprogress_pushtrace(threadinfo->trace, CPROGRESS_TRACE_FINISH, cprogress_threadinfo_getindex(threadinfo),
+      cprogress_getnanotime(), threadinfo->percentage, NULL);
+    cprogress_pushevent(threadinfo->eventqueue, CPROGRESS_EVENT_THREADFINISH, cprogress_threadinfo_getindex(threadinfo));
+  }
+}
+
+void cprogress_updatethread_progress(cprogress_t *cprogress, int thread_index, uint64_t done, uint64_t total) {
+  if (!cprogress || thread_index < 0 || thread_index >= cprogress_getthreadinfos_length(cprogress)) return;
+  cprogress_threadinfo_updateprogress(&cprogress_getthreadinfo(cprogress, thread_index), done, total);
+}
+
+void cprogress_threadinfo_updateindeterminate(cprogress_threadinfo_t *threadinfo, int is_indeterminate) {
+  if (!threadinfo || !threadinfo->is_running) return;
+
+  cprogress_threadinfo_writebegin(threadinfo);
+  threadinfo->is_indeterminate = is_indeterminate;
+  cprogress_threadinfo_writeend(threadinfo);
+}
+
+void cprogress_updatethread_indeterminate(cprogress_t *cprogress, int thread_index, int is_indeterminate) {
+  if (!cprogress || thread_index < 0 || thread_index >= cprogress_getthreadinfos_length(cprogress)) return;
+  cprogress_threadinfo_updateindeterminate(&cprogress_getthreadinfo(cprogress, thread_index), is_indeterminate);
+}
+
+/* format_index from cprogress_attachformat(...), 0 is the one the instance was created with */
+void cprogress_threadinfo_updateformat(cprogress_threadinfo_t *threadinfo, int format_index) {
+  if (!threadinfo || !threadinfo->is_running || format_index < 0) return;
+
+  cprogress_threadinfo_writebegin(threadinfo);
+  threadinfo->format_index = format_index;
+  cprogress_threadinfo_writeend(threadinfo);
+}
+
+void cprogress_updatethread_format(cprogress_t *cprogress, int thread_index, int format_index) {
+  if (!cprogress || thread_index < 0 || thread_index >= cprogress_getthreadinfos_length(cprogress)) return;
+  cprogress_threadinfo_updateformat(&cprogress_getthreadinfo(cprogress, thread_index), format_index);
+}
+
+
+/*----------------------------------------------------------------------------
+| thread-local accumulator
+----------------------------------------------------------------------------*/
+
+/* find out the next [done] at which cprogress_local_add(...) leaves the fast path */
+void cprogress_local_schedule(cprogress_local_t *local) {
+  uint64_t flush_at = local->flush_count? local->published + local->flush_count: UINT64_MAX;
+  /* the exact end is published once, a loop that overshoots it goes on as before */
+  if (local->total && local->published < local->total && local->total < flush_at) flush_at = local->total;
+  local->flush_at = flush_at;
+  local->clockcheck_countdown = local->flush_ns? CPROGRESS_LOCAL_CLOCKCHECK_INTERVAL: UINT32_MAX;
+}
 
-void cprogress_subscribeevent(cprogress_t *cprogress, cprogress_event_type_t type, cprogress_eventsubscriber_func_t *func) {
+cprogress_local_t cprogress_local_create(cprogress_t *cprogress, int thread_index, uint64_t total, uint32_t flush_count, uint64_t flush_ns) {
+  cprogress_local_t local = {
+    .total = total,
+    .flush_count = flush_count || flush_ns? flush_count: 1,
+    .flush_ns = flush_ns,
+    .last_flush_ns = flush_ns? cprogress_getcoarsenanotime(): 0
+  };
+
+  if (!cprogress || thread_index < 0 || thread_index >= cprogress_getthreadinfos_length(cprogress)) {
+    /* stays on the fast path forever, publishing nothing */
+    local.flush_at = UINT64_MAX;
+    local.clockcheck_countdown = UINT32_MAX;
+    return local;
+  }
+
+  local.threadinfo = &cprogress_getthreadinfo(cprogress, thread_index);
+  cprogress_local_schedule(&local);
+  return local;
+}
+
+void cprogress_local_poll(cprogress_local_t *local) {
+  if (!local) return;
+
+  int should_flush = local->done >= local->flush_at;
+  if (!should_flush && local->flush_ns) {
+    should_flush = cprogress_getcoarsenanotime() - local->last_flush_ns >= local->flush_ns;
+  }
+
+  if (should_flush) {
+    cprogress_local_flush(local);
+  } else {
+    cprogress_local_schedule(local);
+  }
+}
+
+void cprogress_local_flush(cprogress_local_t *local) {
+  if (!local || !local->threadinfo) return;
+
+  cprogress_threadinfo_updateprogress(local->threadinfo, local->done, local->total);
+  local->published = local->done;
+  if (local->flush_ns) local->last_flush_ns = cprogress_getcoarsenanotime();
+  cprogress_local_schedule(local);
+}
+
+
+#define cprogress_iseventtypevalid(type) ((type) != CPROGRESS_EVENT_NONE && (type) < CPROGRESS_EVENT_LENGTH)
+
+int cprogress_pushsubscriber(cprogress_t *cprogress, cprogress_event_type_t type, cprogress_eventsubscriber_t subscriber) {
+  if (!cprogress || !cprogress_iseventtypevalid(type)) return CPROGRESS_ERROR_INVAL;
+
+  size_t *length = &cprogress->subscribers_length[type];
+  if (*length >= CPROGRESS_SUBSCRIBER_MAXLEN) return CPROGRESS_ERROR_BUFFUL;
+  cprogress->subscribers[type][(*length)++] = subscriber;
+  return CPROGRESS_ERROR_OK;
+}
+
+/* as it always did: replaces the one set before by this very function, NULL only clears it */
+int cprogress_subscribeevent(cprogress_t *cprogress, cprogress_event_type_t type, cprogress_eventsubscriber_func_t *func) {
+  if (!cprogress || !cprogress_iseventtypevalid(type)) return CPROGRESS_ERROR_INVAL;
+
+  cprogress_eventsubscriber_t *subscribers = cprogress->subscribers[type];
+  size_t *length = &cprogress->subscribers_length[type];
+  size_t kept_length = 0;
+  for (size_t i = 0; i < *length; ++i) {
+    if (!subscribers[i].func) subscribers[kept_length++] = subscribers[i];
+  }
+  *length = kept_length;
+
+  if (!func) return CPROGRESS_ERROR_OK;
+  return cprogress_pushsubscriber(cprogress, type, (cprogress_eventsubscriber_t) { .func = func });
+}
+
+int cprogress_subscribeevent_userdata(cprogress_t *cprogress, cprogress_event_type_t type, cprogress_eventlistener_func_t *listener, void *userdata) {
+  if (!listener) return CPROGRESS_ERROR_INVAL;
+  return cprogress_pushsubscriber(cprogress, type, (cprogress_eventsubscriber_t) { .listener = listener, .userdata = userdata });
+}
+
+/* one of cprogress_subscribeevent(...) is matched too, passed cast with NULL userdata */
+void cprogress_unsubscribeevent(cprogress_t *cprogress, cprogress_event_type_t type, cprogress_eventlistener_func_t *listener, void *userdata) {
+  if (!cprogress || !cprogress_iseventtypevalid(type)) return;
+
+  cprogress_eventsubscriber_t *subscribers = cprogress->subscribers[type];
+  size_t *length = &cprogress->subscribers_length[type];
+  for (size_t i = 0; i < *length; ++i) {
+    int is_matched = subscribers[i].listener?
+      subscribers[i].listener == listener && subscribers[i].userdata == userdata:
+      (void *) subscribers[i].func == (void *) listener && !userdata;
+    if (is_matched) {
+      /* keep the order of the rest */
+      memmove(&subscribers[i], &subscribers[i + 1], (*length - i - 1) * sizeof(cprogress_eventsubscriber_t));
+      --*length;
+      return;
+    }
+  }
+}
+
+int cprogress_subscribebatch(cprogress_t *cprogress, cprogress_eventbatch_func_t *func, void *userdata) {
+  if (!cprogress || !func) return CPROGRESS_ERROR_INVAL;
+
+  if (cprogress->batchsubscribers_length >= CPROGRESS_SUBSCRIBER_MAXLEN) return CPROGRESS_ERROR_BUFFUL;
+  cprogress->batchsubscribers[cprogress->batchsubscribers_length++] = (cprogress_eventbatchsubscriber_t) {
+    .func = func,
+    .userdata = userdata
+  };
+  return CPROGRESS_ERROR_OK;
+}
+
+void cprogress_unsubscribebatch(cprogress_t *cprogress, cprogress_eventbatch_func_t *func, void *userdata) {
   if (!cprogress) return;
 
-  if (type != CPROGRESS_EVENT_NONE && type < CPROGRESS_EVENT_LENGTH) {
-    cprogress->subscribers[type] = func;
+  cprogress_eventbatchsubscriber_t *subscribers = cprogress->batchsubscribers;
+  size_t *length = &cprogress->batchsubscribers_length;
+  for (size_t i = 0; i < *length; ++i) {
+    if (subscribers[i].func == func && subscribers[i].userdata == userdata) {
+      memmove(&subscribers[i], &subscribers[i + 1], (*length - i - 1) * sizeof(cprogress_eventbatchsubscriber_t));
+      --*length;
+      return;
+    }
   }
 }
 
+/* calls the subscribers of this type right away, on the current thread */
 void cprogress_emitevent(cprogress_t *cprogress, cprogress_event_type_t type, int thread_index) {
   if (!cprogress) return;
 
-  if (type != CPROGRESS_EVENT_NONE && type < CPROGRESS_EVENT_LENGTH ||
-    (thread_index > 0 && thread_index < cprogress->threadinfos_length || thread_index == CPROGRESS_UNDEF)) {
-    cprogress_eventsubscriber_func_t *func = cprogress->subscribers[type];
-    if (func) func(cprogress, type, thread_index);
+  if (cprogress_iseventtypevalid(type) &&
+    ((thread_index >= 0 && thread_index < cprogress_getthreadinfos_length(cprogress)) || thread_index == CPROGRESS_UNDEF)) {
+    cprogress_probe2(event_emit, type, thread_index);
+    cprogress_eventsubscriber_t *subscribers = cprogress->subscribers[type];
+    for (size_t i = 0; i < cprogress->subscribers_length[type]; ++i) {
+      cprogress_eventsubscriber_t *subscriber = &subscribers[i];
+      if (subscriber->listener) {
+        subscriber->listener(cprogress, type, thread_index, subscriber->userdata);
+      } else {
+        subscriber->func(cprogress, type, thread_index);
+      }
+    }
   }
 }
 
+void cprogress_dispatchevents(cprogress_t *cprogress) {
+  if (!cprogress) return;
+
+  cprogress_event_t events[CPROGRESS_EVENTBATCH_MAXLEN];
+  size_t events_length;
+  do {
+    events_length = 0;
+    while (events_length < CPROGRESS_EVENTBATCH_MAXLEN && cprogress_popevent(cprogress->eventqueue, &events[events_length]))
+      ++events_length;
+    if (!events_length) break;
+
+    for (size_t i = 0; i < cprogress->batchsubscribers_length; ++i) {
+      cprogress_eventbatchsubscriber_t *subscriber = &cprogress->batchsubscribers[i];
+      subscriber->func(cprogress, events, events_length, subscriber->userdata);
+    }
+
+    for (size_t i = 0; i < events_length; ++i) {
+      if (cprogress->subscribers_length[events[i].type])
+        cprogress_emitevent(cprogress, events[i].type, events[i].thread_index);
+    }
+  } while (events_length == CPROGRESS_EVENTBATCH_MAXLEN);
+}
+
 
 
 #endif /* !CPROGRESS_IMPL_ */
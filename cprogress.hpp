@@ -0,0 +1,231 @@
+/*
+  CPROGRESS - compile-time formats for C++
+  2024 @ Julian Droske
+
+
+  INTRODUCTION
+  ============
+
+  cprogress_create(...) parses its format when the program runs, into chunks allocated on
+  the heap. In C++ (C++20 or later) the compiler can do the parsing instead:
+
+  | #include "cprogress.hpp"
+  |
+  | cprogress_t cprogress = cprogress_create_compiled<"$=t [$40b#] $p%">(4);
+
+  The format follows exactly the same syntax as cprogress_create(...), see FORMAT in
+  cprogress.h. An invalid one does not compile. The chunk table is a constant in read-only
+  memory, handed to cprogress_create_withchunks(...): nothing is parsed or allocated for
+  the format when the program runs. Everything else is the same, destroy the instance with
+  cprogress_destroy(...) as usual.
+
+  The table itself is
+
+  | cprogress_compiledformat<"$=t [$40b#] $p%">::displaychunks
+
+  in case you'd like to share it between instances, and
+
+  | &cprogress_compiledformat<"$=t [$40b#] $p%">::format
+
+  is the same table as a cprogress_format_t, for cprogress_create_withformat(...) or
+  cprogress_attachformat(...).
+
+  The implementation is still C, define CPROGRESS_IMPL before including cprogress.h in a C
+  source file as usual.
+
+*/
+
+#ifndef CPROGRESS_HPP
+#define CPROGRESS_HPP
+
+
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "cprogress.h"
+
+
+
+/* a string literal as a template argument */
+template <std::size_t N>
+struct cprogress_fmtstring {
+  char chars[N] = {};
+
+  constexpr cprogress_fmtstring(const char (&str)[N]) {
+    for (std::size_t i = 0; i < N; ++i) chars[i] = str[i];
+  }
+};
+
+/* a displaychunk, with literal as an offset in literals since there's no address yet */
+struct cprogress_chunkspec_t {
+  cprogress_displaychunk_type_t type = CPROGRESS_DISPLAYCHUNK_UNKNOWN;
+  char fill_char = 0;
+  std::size_t literal_offset = 0;
+  std::size_t literal_length = 0;
+  int is_autospan = 0;
+  std::size_t span_width = (std::size_t) CPROGRESS_UNDEF;
+};
+
+template <std::size_t N>
+struct cprogress_parsedformat_t {
+  cprogress_error_t error = CPROGRESS_ERROR_OK;
+  std::size_t length = 0;
+  cprogress_chunkspec_t chunks[N] = {}; /* every chunk takes at least one char */
+  /* zero terminated like the ones from cprogress_pushliteral(...) */
+  std::size_t literals_length = 0;
+  char literals[2 * N] = {};
+
+  constexpr void pushliteral(const char *str, std::size_t literal_length) {
+    cprogress_chunkspec_t literal;
+    literal.type = CPROGRESS_DISPLAYCHUNK_LITERAL;
+    literal.literal_offset = literals_length;
+    literal.literal_length = literal_length;
+    for (std::size_t i = 0; i < literal_length; ++i) literals[literals_length++] = str[i];
+    literals[literals_length++] = 0;
+    push(literal);
+  }
+
+  constexpr void push(const cprogress_chunkspec_t &chunk) {
+    chunks[length++] = chunk;
+  }
+};
+
+/* mirrors the parser of cprogress_create(...) */
+template <std::size_t N>
+constexpr cprogress_parsedformat_t<N> cprogress_parseformat(const cprogress_fmtstring<N> &fmt) {
+  cprogress_parsedformat_t<N> parsed;
+  const char *str = fmt.chars;
+
+  auto isnumber = [](char ch) { return ch >= '0' && ch <= '9'; };
+  auto isliteral = [](char ch) { return (ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z'); };
+  auto fail = [&parsed]() {
+    parsed.error = CPROGRESS_ERROR_INVAL;
+    return parsed;
+  };
+
+  std::size_t literal_offset = 0;
+  std::size_t literal_length = 0;
+  int has_autospan_element = 0;
+
+  char last_ch = 0;
+  for (std::size_t i = 0; str[i]; ++i) {
+    if (str[i] != '$' || last_ch == '$') {
+      if (!literal_length) literal_offset = i;
+      ++literal_length;
+      last_ch = str[i];
+      continue;
+    }
+
+    if (literal_length) {
+      parsed.pushliteral(str + literal_offset, literal_length);
+      literal_length = 0;
+    }
+
+    cprogress_chunkspec_t chunk;
+
+    /* $[=|number]... till a conversion letter */
+    char fmt_name = 0;
+    ++i;
+    while (str[i] && !fmt_name) {
+      if (str[i] == '=') {
+        if (has_autospan_element) return fail();
+        chunk.is_autospan = has_autospan_element = 1;
+        ++i;
+      } else if (isnumber(str[i])) {
+        std::size_t number = 0;
+        while (isnumber(str[i])) number = number * 10 + (str[i++] - '0');
+        chunk.span_width = number;
+      } else if (isliteral(str[i])) {
+        fmt_name = str[i];
+      } else {
+        return fail();
+      }
+    }
+
+    if (chunk.span_width != (std::size_t) CPROGRESS_UNDEF && chunk.is_autospan) return fail();
+
+    switch (fmt_name) {
+      default: return fail();
+      case 't': chunk.type = CPROGRESS_DISPLAYCHUNK_TITLE; break;
+      case 'b':
+        chunk.type = CPROGRESS_DISPLAYCHUNK_BAR;
+        if (!str[i + 1]) return fail();
+        chunk.fill_char = str[++i];
+        break;
+      case 'p': chunk.type = CPROGRESS_DISPLAYCHUNK_PERCENTAGE; break;
+      case 'r': chunk.type = CPROGRESS_DISPLAYCHUNK_RATE; break;
+      case 'R': chunk.type = CPROGRESS_DISPLAYCHUNK_BYTERATE; break;
+      case 'e': chunk.type = CPROGRESS_DISPLAYCHUNK_ETA; break;
+      case 'T': chunk.type = CPROGRESS_DISPLAYCHUNK_ELAPSED; break;
+      case 's': chunk.type = CPROGRESS_DISPLAYCHUNK_SPINNER; break;
+      case 'c': chunk.type = CPROGRESS_DISPLAYCHUNK_COUNT; break;
+      case 'B': chunk.type = CPROGRESS_DISPLAYCHUNK_BYTES; break;
+    }
+
+    if (chunk.type == CPROGRESS_DISPLAYCHUNK_BAR && chunk.span_width == (std::size_t) CPROGRESS_UNDEF && !chunk.is_autospan)
+      return fail();
+
+    parsed.push(chunk);
+    last_ch = str[i];
+  }
+
+  if (literal_length) parsed.pushliteral(str + literal_offset, literal_length);
+
+  return parsed;
+}
+
+template <cprogress_fmtstring Fmt>
+struct cprogress_compiledformat {
+  static constexpr cprogress_parsedformat_t parsed = cprogress_parseformat(Fmt);
+  static_assert(parsed.error == CPROGRESS_ERROR_OK, "cprogress: invalid format");
+
+  static constexpr std::size_t length = parsed.length;
+  static_assert(length <= CPROGRESS_DISPLAYCHUNK_MAXLEN, "cprogress: more than CPROGRESS_DISPLAYCHUNK_MAXLEN chunks in format");
+
+  /* terminated by a zeroed chunk, as cprogress_create(...) does */
+  static constexpr std::array<cprogress_displaychunk_t, length + 1> makedisplaychunks() {
+    std::array<cprogress_displaychunk_t, length + 1> displaychunks = {};
+    for (std::size_t i = 0; i < length; ++i) {
+      const cprogress_chunkspec_t &chunk = parsed.chunks[i];
+      cprogress_displaychunk_t &displaychunk = displaychunks[i];
+      displaychunk.type = chunk.type;
+      if (chunk.type == CPROGRESS_DISPLAYCHUNK_LITERAL) displaychunk.literal = parsed.literals + chunk.literal_offset;
+      else displaychunk.fill_char = chunk.fill_char;
+      displaychunk.literal_length = chunk.literal_length;
+      displaychunk.is_autospan = chunk.is_autospan;
+      displaychunk.span_width = chunk.span_width;
+    }
+    return displaychunks;
+  }
+
+  static constexpr std::array<cprogress_displaychunk_t, length + 1> displaychunks = makedisplaychunks();
+
+  static constexpr cprogress_format_t makeformat() {
+    cprogress_format_t format = {};
+    format.refcount = 1;
+    format.displaychunks_length = length + 1;
+    format.displaychunks = const_cast<cprogress_displaychunk_t *>(displaychunks.data());
+    format.literals_length = parsed.literals_length;
+    format.literals = const_cast<char *>(parsed.literals);
+    format.displaychunk_types = 1u << CPROGRESS_DISPLAYCHUNK_UNKNOWN;
+    for (std::size_t i = 0; i < length; ++i) {
+      format.has_autospan_element |= displaychunks[i].is_autospan;
+      format.displaychunk_types |= 1u << displaychunks[i].type;
+    }
+    return format;
+  }
+
+  /* the same table as a format object, lives as long as the program and is never freed */
+  static inline cprogress_format_t format = makeformat();
+};
+
+template <cprogress_fmtstring Fmt>
+inline cprogress_t cprogress_create_compiled(int thread_count) {
+  return cprogress_create_withchunks(cprogress_compiledformat<Fmt>::displaychunks.data(), thread_count);
+}
+
+
+
+#endif /* !CPROGRESS_HPP */
@@ -0,0 +1,192 @@
+#include "stdio.h"
+#include "stdlib.h"
+#include "string.h"
+#include "time.h"
+#include "unistd.h"
+
+#define CPROGRESS_IMPL
+#include "../cprogress.h"
+
+
+/*
+  render path benchmarks, one result per row:
+    benchmark,format,title_length,console_width,slots,ns_per_op,ns_per_line
+  or one JSON object per line with -json. Rendered output goes to /dev/null, results to
+  the stdout the program was started with.
+*/
+
+
+#define BENCH_MIN_NS 100000000ULL /* per case */
+#define BENCH_TITLE_MAXLEN 128
+
+uint64_t bench_getnanotime() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+FILE *bench_results = NULL;
+int bench_is_json = 0;
+volatile size_t bench_sink = 0; /* keeps the writes */
+
+void bench_report(const char *benchmark, const char *fmt, int title_length, int console_width, int slots,
+  double ns_per_op, double ns_per_line) {
+  if (bench_is_json) {
+    fprintf(bench_results, "{\"benchmark\": \"%s\", \"format\": \"%s\", \"title_length\": %d, \"console_width\": %d, "
+      "\"slots\": %d, \"ns_per_op\": %.1f, \"ns_per_line\": %.1f}\n",
+      benchmark, fmt, title_length, console_width, slots, ns_per_op, ns_per_line);
+  } else {
+    fprintf(bench_results, "%s,\"%s\",%d,%d,%d,%.1f,%.1f\n",
+      benchmark, fmt, title_length, console_width, slots, ns_per_op, ns_per_line);
+  }
+  fflush(bench_results);
+}
+
+void bench_maketitle(char *title, int title_length) {
+  for (int i = 0; i < title_length; ++i) title[i] = 'a' + i % 26;
+  title[title_length] = 0;
+}
+
+/* runs the body as many times as fits BENCH_MIN_NS, ns per run is left in [ns] */
+#define bench_loop(ns, body) { \
+  uint64_t runs = 0; \
+  uint64_t begin = bench_getnanotime(), elapsed = 0; \
+  do { \
+    for (int i = 0; i < 64; ++i) { body; } \
+    runs += 64; \
+  } while ((elapsed = bench_getnanotime() - begin) < BENCH_MIN_NS); \
+  ns = (double) elapsed / runs; \
+}
+
+
+/* pieces of a line */
+
+
+void bench_snprintw() {
+  static const int title_lengths[] = { 8, 32, 128 };
+  static const int console_widths[] = { 80, 200, 500 };
+  char title[BENCH_TITLE_MAXLEN + 1];
+  char buf[500 * 4 + 1];
+
+  for (int t = 0; t < sizeof(title_lengths) / sizeof(title_lengths[0]); ++t) {
+    bench_maketitle(title, title_lengths[t]);
+    for (int w = 0; w < sizeof(console_widths) / sizeof(console_widths[0]); ++w) {
+      double ns;
+      bench_loop(ns, bench_sink += cprogress_snprintw(buf, sizeof(buf), title, console_widths[w]));
+      bench_report("snprintw", "", title_lengths[t], console_widths[w], 1, ns, ns);
+    }
+  }
+}
+
+void bench_writepercentage() {
+  char buf[64];
+  double ns;
+  float percentage = 0;
+  bench_loop(ns, {
+    bench_sink += cprogress_writepercentage(buf, sizeof(buf), percentage, 7);
+    percentage = percentage < 100? percentage + 0.37f: 0;
+  });
+  bench_report("writepercentage", "", 0, 7, 1, ns, ns);
+}
+
+void bench_writeprogressbar() {
+  static const int bar_lengths[] = { 40, 200, 500 };
+  char buf[500];
+
+  for (int b = 0; b < sizeof(bar_lengths) / sizeof(bar_lengths[0]); ++b) {
+    double ns;
+    float percentage = 0;
+    bench_loop(ns, {
+      bench_sink += cprogress_writeprogressbar(buf, bar_lengths[b], '#', percentage);
+      percentage = percentage < 100? percentage + 0.37f: 0;
+    });
+    bench_report("writeprogressbar", "", 0, bar_lengths[b], 1, ns, ns);
+  }
+}
+
+
+/* whole lines and frames */
+
+
+static const char *bench_formats[] = {
+  "$=t [$40b#] $p%",
+  "$t [$=b#] $5p%",
+  "$s $=t [$20b=] $c $B $R eta $e $T"
+};
+#define BENCH_FORMATS_LENGTH (sizeof(bench_formats) / sizeof(bench_formats[0]))
+
+void bench_writeline() {
+  static const int title_lengths[] = { 8, 32, 128 };
+  static const int console_widths[] = { 80, 120, 200, 500 };
+  char title[BENCH_TITLE_MAXLEN + 1];
+  char buf[500 * 4 + 1];
+
+  for (int f = 0; f < BENCH_FORMATS_LENGTH; ++f) {
+    cprogress_t cprogress = cprogress_create(bench_formats[f], 0);
+    for (int t = 0; t < sizeof(title_lengths) / sizeof(title_lengths[0]); ++t) {
+      bench_maketitle(title, title_lengths[t]);
+      for (int w = 0; w < sizeof(console_widths) / sizeof(console_widths[0]); ++w) {
+        double ns;
+        float percentage = 0;
+        bench_loop(ns, {
+          bench_sink += cprogress_writeline(&cprogress, buf, sizeof(buf), console_widths[w], title, percentage);
+          percentage = percentage < 100? percentage + 0.37f: 0;
+        });
+        bench_report("writeline", bench_formats[f], title_lengths[t], console_widths[w], 1, ns, ns);
+      }
+    }
+    cprogress_destroy(&cprogress);
+  }
+}
+
+/* cprogress_render(...) into the null sink, at the width it falls back to without a terminal */
+void bench_render() {
+  static const int slots_lengths[] = { 1, 100, 10000, 100000 };
+  char title[BENCH_TITLE_MAXLEN + 1];
+  bench_maketitle(title, 32);
+
+  for (int f = 0; f < BENCH_FORMATS_LENGTH; ++f) {
+    for (int s = 0; s < sizeof(slots_lengths) / sizeof(slots_lengths[0]); ++s) {
+      int slots = slots_lengths[s];
+      cprogress_t cprogress = cprogress_create(bench_formats[f], slots);
+      cprogress_startallthreads(&cprogress);
+      for (int i = 0; i < slots; ++i) {
+        cprogress_updatethread_title(&cprogress, i, title);
+        cprogress_updatethread_progress(&cprogress, i, i % 100, 100);
+      }
+
+      uint64_t frames = 0;
+      uint64_t begin = bench_getnanotime(), elapsed = 0;
+      do {
+        cprogress_render(&cprogress);
+        ++frames;
+      } while ((elapsed = bench_getnanotime() - begin) < BENCH_MIN_NS);
+
+      double ns = (double) elapsed / frames;
+      bench_report("render", bench_formats[f], 32, cprogress.console_width, slots, ns, ns / slots);
+      cprogress_destroy(&cprogress);
+    }
+  }
+}
+
+
+int main(int argc, char **argv) {
+  bench_is_json = argc > 1 && !strcmp(argv[1], "-json");
+
+  /* results keep the original stdout, everything cprogress prints is thrown away */
+  bench_results = fdopen(dup(STDOUT_FILENO), "w");
+  if (!bench_results || !freopen("/dev/null", "w", stdout)) {
+    perror("bench");
+    return 1;
+  }
+
+  if (!bench_is_json) fprintf(bench_results, "benchmark,format,title_length,console_width,slots,ns_per_op,ns_per_line\n");
+  bench_snprintw();
+  bench_writepercentage();
+  bench_writeprogressbar();
+  bench_writeline();
+  bench_render();
+
+  fclose(bench_results);
+  return 0;
+}
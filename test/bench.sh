@@ -0,0 +1,5 @@
+#!/bin/sh
+
+# render path timings as CSV, pass -json for one JSON object per line
+gcc -o bench -O2 bench.c -pthread &&
+./bench "$@"
@@ -0,0 +1,258 @@
+#include "stdio.h"
+#include "stdlib.h"
+#include "string.h"
+#include "time.h"
+#include "unistd.h"
+
+#include "pthread.h"
+#include "sched.h"
+#include "sys/ioctl.h"
+#include "sys/syscall.h"
+#include "linux/perf_event.h"
+
+#define CPROGRESS_IMPL
+#include "../cprogress.h"
+
+
+/*
+  update path under contention, one result per row:
+    benchmark,slot,threads,renderer,ns_per_op,p99_ns,cache_misses_per_op
+  or one JSON object per line with -json.
+
+  slot is where the updaters write:
+    own: each thread its own slot, as the library expects
+    parent: own slots, all attached to one parent that every update rolls up into
+    same: one slot for all, taken in turn under a spinlock since only one updater at a time
+      is allowed per slot, so it shows how the slot bounces between cores
+  ns_per_op is cpu time of the updaters, waiting for a core is left out. Every
+  BENCH_SAMPLE_INTERVAL-th op is timed on its own for p99, in wall time including one clock
+  read. Cache misses are counted with perf_event_open(2), -1 where it is not permitted.
+*/
+
+
+#define BENCH_MIN_NS 100000000ULL /* per case */
+#define BENCH_THREAD_MAXLEN 256
+#define BENCH_SAMPLE_INTERVAL 16
+#define BENCH_SAMPLE_MAXLEN 8192 /* per thread */
+
+uint64_t bench_getnanotime() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* time the calling thread was on a core, so that ns/op holds with more threads than cores */
+uint64_t bench_getthreadnanotime() {
+  struct timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+FILE *bench_results = NULL;
+int bench_is_json = 0;
+
+
+/* perf counters, per thread */
+
+
+int bench_openperf(uint64_t config) {
+  struct perf_event_attr attr = {
+    .type = PERF_TYPE_HARDWARE,
+    .size = sizeof(struct perf_event_attr),
+    .config = config,
+    .disabled = 1,
+    .exclude_kernel = 1,
+    .exclude_hv = 1
+  };
+  return syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+int64_t bench_readperf(int fd) {
+  uint64_t value;
+  if (fd < 0 || read(fd, &value, sizeof(value)) != sizeof(value)) return -1;
+  return value;
+}
+
+
+/* updaters */
+
+
+typedef enum {
+  BENCH_OP_PERCENTAGE,
+  BENCH_OP_TITLE
+} bench_op_t;
+
+typedef enum {
+  BENCH_SLOT_OWN,
+  BENCH_SLOT_PARENT,
+  BENCH_SLOT_SAME
+} bench_slot_t;
+
+typedef struct {
+  cprogress_t *cprogress;
+  int thread_index;
+  bench_op_t op;
+  bench_slot_t slot;
+
+  uint64_t ops;
+  uint64_t elapsed_ns;
+  size_t samples_length;
+  uint32_t samples[BENCH_SAMPLE_MAXLEN];
+  int64_t cache_misses;
+} bench_threaddata_t;
+
+pthread_barrier_t bench_barrier;
+int bench_is_stopping = 0;
+int bench_samelock = 0;
+
+void bench_update(bench_threaddata_t *td, uint64_t i) {
+  static const char *titles[2] = { "Copying shard", "Verifying shard" };
+  if (td->slot == BENCH_SLOT_SAME) {
+    /* yields now and then, there may be more updaters than cores */
+    for (int spins = 1; __atomic_exchange_n(&bench_samelock, 1, __ATOMIC_ACQUIRE); ++spins) {
+      if (spins % 64) cprogress_cpurelax();
+      else sched_yield();
+    }
+  }
+
+  if (td->op == BENCH_OP_PERCENTAGE) cprogress_updatethread_percentage(td->cprogress, td->thread_index, i % 100);
+  else cprogress_updatethread_title(td->cprogress, td->thread_index, titles[i & 1]);
+
+  if (td->slot == BENCH_SLOT_SAME) __atomic_store_n(&bench_samelock, 0, __ATOMIC_RELEASE);
+}
+
+void *bench_thread_worker(void *userdata) {
+  bench_threaddata_t *td = (bench_threaddata_t *) userdata;
+
+  int perf_fd = bench_openperf(PERF_COUNT_HW_CACHE_MISSES);
+  pthread_barrier_wait(&bench_barrier);
+  if (perf_fd >= 0) ioctl(perf_fd, PERF_EVENT_IOC_ENABLE, 0);
+
+  uint64_t i = 0;
+  uint64_t begin = bench_getthreadnanotime();
+  while (!__atomic_load_n(&bench_is_stopping, __ATOMIC_RELAXED)) {
+    for (int k = 0; k < BENCH_SAMPLE_INTERVAL - 1; ++k) bench_update(td, i++);
+
+    uint64_t sample_begin = bench_getnanotime();
+    bench_update(td, i++);
+    uint64_t sample_ns = bench_getnanotime() - sample_begin;
+    if (td->samples_length < BENCH_SAMPLE_MAXLEN) td->samples[td->samples_length++] = sample_ns;
+  }
+  td->elapsed_ns = bench_getthreadnanotime() - begin;
+  td->ops = i;
+
+  if (perf_fd >= 0) {
+    ioctl(perf_fd, PERF_EVENT_IOC_DISABLE, 0);
+    td->cache_misses = bench_readperf(perf_fd);
+    close(perf_fd);
+  } else {
+    td->cache_misses = -1;
+  }
+  return NULL;
+}
+
+
+/* cases */
+
+
+int bench_compareu32(const void *a, const void *b) {
+  uint32_t x = *(const uint32_t *) a, y = *(const uint32_t *) b;
+  return x < y? -1: x > y;
+}
+
+void bench_case(bench_op_t op, bench_slot_t slot, int threads_length, int has_renderer) {
+  static const char *op_names[] = { "updatethread_percentage", "updatethread_title" };
+  static const char *slot_names[] = { "own", "parent", "same" };
+  static bench_threaddata_t threaddatas[BENCH_THREAD_MAXLEN];
+  static uint32_t samples[BENCH_THREAD_MAXLEN * BENCH_SAMPLE_MAXLEN];
+  pthread_t threads[BENCH_THREAD_MAXLEN];
+
+  /* slot 0 is the parent, or the one slot everybody shares */
+  cprogress_t cprogress = cprogress_create("$=t [$40b#] $p%", threads_length + 1);
+  cprogress_startallthreads(&cprogress);
+  if (slot == BENCH_SLOT_PARENT) {
+    for (int i = 0; i < threads_length; ++i) cprogress_attachthread(&cprogress, i + 1, 0, 1);
+  }
+
+  __atomic_store_n(&bench_is_stopping, 0, __ATOMIC_RELAXED);
+  pthread_barrier_init(&bench_barrier, NULL, threads_length + 1);
+  for (int i = 0; i < threads_length; ++i) {
+    threaddatas[i] = (bench_threaddata_t) {
+      .cprogress = &cprogress,
+      .thread_index = slot == BENCH_SLOT_SAME? 0: i + 1,
+      .op = op,
+      .slot = slot
+    };
+    pthread_create(&threads[i], NULL, bench_thread_worker, &threaddatas[i]);
+  }
+  pthread_barrier_wait(&bench_barrier);
+
+  uint64_t begin = bench_getnanotime();
+  while (bench_getnanotime() - begin < BENCH_MIN_NS) {
+    if (has_renderer) {
+      cprogress_render(&cprogress);
+      cprogress_dispatchevents(&cprogress);
+    }
+    cprogress_msleep(1000 / 60);
+  }
+  __atomic_store_n(&bench_is_stopping, 1, __ATOMIC_RELAXED);
+
+  uint64_t ops = 0;
+  double thread_ns = 0;
+  int64_t cache_misses = 0;
+  size_t samples_length = 0;
+  for (int i = 0; i < threads_length; ++i) {
+    pthread_join(threads[i], NULL);
+    bench_threaddata_t *td = &threaddatas[i];
+    ops += td->ops;
+    thread_ns += td->elapsed_ns;
+    if (cache_misses >= 0) cache_misses = td->cache_misses >= 0? cache_misses + td->cache_misses: -1;
+    memcpy(samples + samples_length, td->samples, td->samples_length * sizeof(uint32_t));
+    samples_length += td->samples_length;
+  }
+  pthread_barrier_destroy(&bench_barrier);
+  cprogress_destroy(&cprogress);
+
+  qsort(samples, samples_length, sizeof(uint32_t), bench_compareu32);
+  double ns_per_op = thread_ns / ops; /* cpu time of the updaters */
+  uint32_t p99_ns = samples_length? samples[samples_length * 99 / 100]: 0;
+  double misses_per_op = cache_misses >= 0? (double) cache_misses / ops: -1;
+
+  if (bench_is_json) {
+    fprintf(bench_results, "{\"benchmark\": \"%s\", \"slot\": \"%s\", \"threads\": %d, \"renderer\": %d, "
+      "\"ns_per_op\": %.1f, \"p99_ns\": %u, \"cache_misses_per_op\": %.3f}\n",
+      op_names[op], slot_names[slot], threads_length, has_renderer, ns_per_op, p99_ns, misses_per_op);
+  } else {
+    fprintf(bench_results, "%s,%s,%d,%d,%.1f,%u,%.3f\n",
+      op_names[op], slot_names[slot], threads_length, has_renderer, ns_per_op, p99_ns, misses_per_op);
+  }
+  fflush(bench_results);
+}
+
+
+int main(int argc, char **argv) {
+  static const int threads_lengths[] = { 1, 8, 64, BENCH_THREAD_MAXLEN };
+  bench_is_json = argc > 1 && !strcmp(argv[1], "-json");
+
+  /* results keep the original stdout, everything cprogress prints is thrown away */
+  bench_results = fdopen(dup(STDOUT_FILENO), "w");
+  if (!bench_results || !freopen("/dev/null", "w", stdout)) {
+    perror("bench_contention");
+    return 1;
+  }
+
+  if (!bench_is_json) fprintf(bench_results, "benchmark,slot,threads,renderer,ns_per_op,p99_ns,cache_misses_per_op\n");
+  for (bench_op_t op = BENCH_OP_PERCENTAGE; op <= BENCH_OP_TITLE; ++op) {
+    for (bench_slot_t slot = BENCH_SLOT_OWN; slot <= BENCH_SLOT_SAME; ++slot) {
+      /* a title never rolls up, parent would be the same as own */
+      if (op == BENCH_OP_TITLE && slot == BENCH_SLOT_PARENT) continue;
+      for (int t = 0; t < sizeof(threads_lengths) / sizeof(threads_lengths[0]); ++t) {
+        bench_case(op, slot, threads_lengths[t], 0);
+        bench_case(op, slot, threads_lengths[t], 1);
+      }
+    }
+  }
+
+  fclose(bench_results);
+  return 0;
+}
@@ -0,0 +1,5 @@
+#!/bin/sh
+
+# update path timings as CSV, pass -json for one JSON object per line
+gcc -o bench_contention -O2 bench_contention.c -pthread &&
+./bench_contention "$@"
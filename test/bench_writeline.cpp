@@ -0,0 +1,73 @@
+#include "cstdio"
+#include "cstdlib"
+#include "ctime"
+
+#include "../cprogress.hpp"
+
+
+/*
+  the same writer over the chunk table cprogress.hpp compiles into the program and over the
+  one parsed into the arena at run time, from 1 to 10,000 lines per frame
+*/
+
+#define BENCH_FORMAT "$=t [$40b#] $p% $c $r"
+#define BENCH_CONSOLE_WIDTH 120
+#define BENCH_MIN_NS 200000000ULL /* per case */
+
+
+uint64_t bench_getnanotime() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* draws lines_length lines as many times as fits BENCH_MIN_NS, returns ns per line */
+double bench_lines(cprogress_t *cprogress, const cprogress_lineinfo_t *lineinfos, size_t lines_length) {
+  char buf[BENCH_CONSOLE_WIDTH * 4];
+  size_t sink = 0;
+
+  uint64_t lines_written = 0;
+  uint64_t begin = bench_getnanotime(), elapsed = 0;
+  do {
+    for (size_t i = 0; i < lines_length; ++i) {
+      cprogress_writelineinfo(cprogress, buf, sizeof(buf), BENCH_CONSOLE_WIDTH, &lineinfos[i]);
+      sink += buf[i % BENCH_CONSOLE_WIDTH];
+    }
+    lines_written += lines_length;
+  } while ((elapsed = bench_getnanotime() - begin) < BENCH_MIN_NS);
+
+  if (sink == 1) puts(""); /* keep the writes */
+  return (double) elapsed / lines_written;
+}
+
+
+int main(void) {
+  cprogress_t parsed = cprogress_create(BENCH_FORMAT, 0);
+  cprogress_t compiled = cprogress_create_compiled<BENCH_FORMAT>(0);
+  if (parsed.error || compiled.error) {
+    printf("error occured with code %d, %d\n", parsed.error, compiled.error);
+    return 1;
+  }
+
+  static char titles[10000][32];
+  static cprogress_lineinfo_t lineinfos[10000];
+  for (size_t i = 0; i < 10000; ++i) {
+    snprintf(titles[i], sizeof(titles[i]), "Copying shard %zu", i);
+    lineinfos[i] = cprogress_lineinfo_make(titles[i], (i * 37) % 1000 / 10.0f);
+    lineinfos[i].done = i * 1234;
+    lineinfos[i].total = 10000 * 1234;
+    lineinfos[i].rate = i * 3.5;
+  }
+
+  printf("format: \"%s\", console width %d\n", BENCH_FORMAT, BENCH_CONSOLE_WIDTH);
+  printf("%8s %16s %16s %8s\n", "lines", "parsed ns", "compiled ns", "speedup");
+  for (size_t lines_length = 1; lines_length <= 10000; lines_length *= 10) {
+    double parsed_ns = bench_lines(&parsed, lineinfos, lines_length);
+    double compiled_ns = bench_lines(&compiled, lineinfos, lines_length);
+    printf("%8zu %16.1f %16.1f %7.2fx\n", lines_length, parsed_ns, compiled_ns, parsed_ns / compiled_ns);
+  }
+
+  cprogress_destroy(&parsed);
+  cprogress_destroy(&compiled);
+  return 0;
+}
@@ -0,0 +1,6 @@
+#!/bin/sh
+
+# cprogress_writelineinfo(...) over the table compiled by cprogress.hpp against the parsed one
+gcc -c -o cprogress.o -O2 -x c -DCPROGRESS_IMPL ../cprogress.h &&
+g++ -std=c++20 -o bench_writeline -O2 bench_writeline.cpp cprogress.o &&
+./bench_writeline
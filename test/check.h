@@ -0,0 +1,51 @@
+/*
+  what the test_*.c checks share, included after the implementation:
+
+  | cprogress_t cprogress = check_create(fmt, thread_count);
+  | check(condition, printf-like message);
+  | return check_end("what held");
+
+  a failed check prints its message to stderr and goes on, check_end(...) returns non-zero
+  when any failed, so the .sh runner fails with it
+*/
+
+#ifndef CPROGRESS_CHECK_H
+#define CPROGRESS_CHECK_H
+
+#include "stdarg.h"
+#include "stdio.h"
+#include "stdlib.h"
+
+int check_failed_count = 0;
+
+/* from any thread, evaluates to the condition */
+#define check(condition, ...) ((condition)? 1: check_fail(__VA_ARGS__))
+
+__attribute__((format(printf, 1, 2)))
+int check_fail(const char *fmt, ...) {
+  va_list args;
+  va_start(args, fmt);
+  vfprintf(stderr, fmt, args);
+  va_end(args);
+  fputc('\n', stderr);
+  __atomic_add_fetch(&check_failed_count, 1, __ATOMIC_RELAXED);
+  return 0;
+}
+
+/* nothing else to check without an instance */
+cprogress_t check_create(const char *fmt, int thread_count) {
+  cprogress_t cprogress = cprogress_create(fmt, thread_count);
+  if (cprogress.error) {
+    fprintf(stderr, "error occured with code %d\n", cprogress.error);
+    exit(1);
+  }
+  return cprogress;
+}
+
+int check_end(const char *message) {
+  int failed_count = __atomic_load_n(&check_failed_count, __ATOMIC_RELAXED);
+  if (!failed_count) fprintf(stderr, "%s\n", message);
+  return failed_count != 0;
+}
+
+#endif
@@ -1,4 +1,6 @@
 #include "stdio.h"
+#include "signal.h"
+#include "sys/wait.h"
 
 #include "../cprogress.h"
 
@@ -14,7 +16,7 @@
 
 
 void print_displaychunks(cprogress_t *cprogress) {
-  printf("there are %d displaychunks.\n", cprogress->displaychunks_length);
+  printf("there are %d displaychunks.\n", cprogress->formats[0]->displaychunks_length);
   cprogress_displaychunk_foreach(cprogress, displaychunk) {
     switch (displaychunk->type) {
       default:
@@ -56,7 +58,7 @@ int test_internal() {
 
   print_displaychunks(&cprogress);
 
-  char buf[81];
+  char buf[81] = {};
   cprogress_writeline(&cprogress, buf, 80, 80, "HELLO", 40);
   printf("result: %s\n", buf);
 
@@ -164,6 +166,670 @@ int demo() {
 
 
 
+/* test thread-local accumulator */
+
+
+void *local_thread_worker(void *userdata) {
+  demo_threaddata_t *td = (demo_threaddata_t *) userdata;
+
+  /* publish every 100000 items or every 50ms */
+  cprogress_local_t local = cprogress_local_create(td->cprogress, td->thread_index, 200000000, 100000, 50000000);
+  for (int i = 0; i < 200000000; ++i) {
+    cprogress_local_add(&local, 1);
+  }
+  cprogress_local_flush(&local);
+  return NULL;
+}
+
+int local_finished_count = 0;
+int local_batch_count = 0;
+
+void local_on_threadfinish(cprogress_t *cprogress, cprogress_event_type_t type, int thread_index, void *userdata) {
+  ++*(int *) userdata;
+}
+
+void local_on_batch(cprogress_t *cprogress, const cprogress_event_t *events, size_t events_length, void *userdata) {
+  ++*(int *) userdata;
+}
+
+void local_on_finish(cprogress_t *cprogress, cprogress_event_type_t type, int thread_index) {
+  printf("all done, %d threads finished, events came in %d batches\n", local_finished_count, local_batch_count);
+}
+
+int test_local() {
+  cprogress_t cprogress = cprogress_create("$=t [$40b#] $p%", 4);
+  if (cprogress.error) {
+    printf("error occured with code %d\n", cprogress.error);
+    return 1;
+  }
+
+  /* events are delivered by cprogress_render_tillcomplete(...) on this thread, once each */
+  cprogress_subscribeevent_userdata(&cprogress, CPROGRESS_EVENT_THREADFINISH, local_on_threadfinish, &local_finished_count);
+  cprogress_subscribebatch(&cprogress, local_on_batch, &local_batch_count);
+  cprogress_subscribeevent(&cprogress, CPROGRESS_EVENT_FINISH, local_on_finish);
+
+  demo_threaddata_t threaddatas[4] = {};
+  for (int i = 0; i < 4; ++i) {
+    cprogress_startthread(&cprogress, i);
+    cprogress_updatethread_title(&cprogress, i, "Counting items");
+
+    threaddatas[i] = (demo_threaddata_t) { &cprogress, i };
+    jl_createthread(local_thread_worker, &threaddatas[i], 0);
+  }
+
+  cprogress_render_tillcomplete(&cprogress, 30);
+
+  cprogress_destroy(&cprogress);
+  return 0;
+}
+
+
+
+/* test pool */
+
+
+int pool_workers_done = 0;
+
+void *pool_thread_worker(void *userdata) {
+  cprogress_t *cprogress = (cprogress_t *) userdata;
+
+  for (int task = 0; task < 20; ++task) {
+    /* a thread_index only lives as long as the task */
+    int thread_index = cprogress_acquire(cprogress);
+    if (thread_index == CPROGRESS_UNDEF) break;
+
+    char title[64] = {};
+    snprintf(title, 63, "Short task %d", task);
+    cprogress_updatethread_title(cprogress, thread_index, title);
+    for (int i = 0; i < 10; ++i) {
+      cprogress_updatethread_progress(cprogress, thread_index, i, 10);
+      jl_millisleep(20);
+    }
+
+    cprogress_release(cprogress, thread_index);
+  }
+
+  __atomic_fetch_add(&pool_workers_done, 1, __ATOMIC_RELEASE);
+  return NULL;
+}
+
+int test_pool() {
+  cprogress_t cprogress = cprogress_create("$=t [$40b#] $p%", 0);
+  if (cprogress.error) {
+    printf("error occured with code %d\n", cprogress.error);
+    return 1;
+  }
+
+  for (int i = 0; i < 8; ++i) {
+    jl_createthread(pool_thread_worker, &cprogress, 0);
+  }
+
+  /* cprogress_stillrunning(...) would stop between two tasks, so wait for workers instead */
+  while (__atomic_load_n(&pool_workers_done, __ATOMIC_ACQUIRE) < 8) {
+    cprogress_render(&cprogress);
+    cprogress_dispatchevents(&cprogress);
+    cprogress_waitfps(30);
+  }
+  cprogress_render(&cprogress);
+
+  printf("%zu thread data were used for 160 tasks\n", cprogress.threadinfos_length);
+
+  cprogress_destroy(&cprogress);
+  return 0;
+}
+
+
+
+/* test hierarchy */
+
+
+#define TREE_JOB_COUNT 2
+#define TREE_STAGE_COUNT 3
+#define TREE_SHARD_COUNT 4
+
+typedef struct {
+  cprogress_t *cprogress;
+  int stage_index;
+  int shard_indices[TREE_SHARD_COUNT];
+} tree_stagedata_t;
+
+void *tree_thread_stage(void *userdata) {
+  tree_stagedata_t *sd = (tree_stagedata_t *) userdata;
+
+  for (int step = 1; step <= 20; ++step) {
+    for (int i = 0; i < TREE_SHARD_COUNT; ++i) {
+      cprogress_updatethread_progress(sd->cprogress, sd->shard_indices[i], step * (i + 1), 20 * (i + 1));
+    }
+    jl_millisleep(100 + sd->stage_index * 20);
+  }
+  cprogress_abortthread(sd->cprogress, sd->stage_index);
+  return NULL;
+}
+
+/* parents don't stop by themselves */
+void tree_on_threadfinish(cprogress_t *cprogress, cprogress_event_type_t type, int thread_index, void *userdata) {
+  int parent_index = (int) cprogress_getthreadinfo(cprogress, thread_index).parent - 1;
+  if (parent_index == CPROGRESS_UNDEF) return;
+
+  cprogress_threadsnapshot_t snapshot;
+  cprogress_threadinfo_snapshot(&cprogress_getthreadinfo(cprogress, parent_index), &snapshot);
+  if (snapshot.percentage >= 100) cprogress_abortthread(cprogress, parent_index);
+}
+
+int test_tree() {
+  int thread_count = TREE_JOB_COUNT * (1 + TREE_STAGE_COUNT * (1 + TREE_SHARD_COUNT));
+  cprogress_t cprogress = cprogress_create("$=t [$40b#] $p%", thread_count);
+  if (cprogress.error) {
+    printf("error occured with code %d\n", cprogress.error);
+    return 1;
+  }
+  cprogress_subscribeevent_userdata(&cprogress, CPROGRESS_EVENT_THREADFINISH, tree_on_threadfinish, NULL);
+
+  tree_stagedata_t stagedatas[TREE_JOB_COUNT * TREE_STAGE_COUNT] = {};
+  int thread_index = 0;
+  for (int job = 0; job < TREE_JOB_COUNT; ++job) {
+    int job_index = thread_index++;
+    char title[64] = {};
+    snprintf(title, 63, "Job %d", job);
+    cprogress_startthread(&cprogress, job_index);
+    cprogress_updatethread_title(&cprogress, job_index, title);
+
+    for (int stage = 0; stage < TREE_STAGE_COUNT; ++stage) {
+      tree_stagedata_t *sd = &stagedatas[job * TREE_STAGE_COUNT + stage];
+      *sd = (tree_stagedata_t) { &cprogress, thread_index++ };
+      snprintf(title, 63, "Stage %d", stage);
+      cprogress_startthread(&cprogress, sd->stage_index);
+      cprogress_updatethread_title(&cprogress, sd->stage_index, title);
+      /* later stages weigh more */
+      cprogress_attachthread(&cprogress, sd->stage_index, job_index, stage + 1);
+
+      for (int shard = 0; shard < TREE_SHARD_COUNT; ++shard) {
+        sd->shard_indices[shard] = thread_index++;
+        snprintf(title, 63, "Shard %d", shard);
+        cprogress_startthread(&cprogress, sd->shard_indices[shard]);
+        cprogress_updatethread_title(&cprogress, sd->shard_indices[shard], title);
+        cprogress_attachthread(&cprogress, sd->shard_indices[shard], sd->stage_index, 1);
+      }
+    }
+  }
+
+  /* the second job only shows its own line */
+  cprogress_collapsethread(&cprogress, 1 + TREE_STAGE_COUNT * (1 + TREE_SHARD_COUNT), 1);
+
+  for (int i = 0; i < TREE_JOB_COUNT * TREE_STAGE_COUNT; ++i) {
+    jl_createthread(tree_thread_stage, &stagedatas[i], 0);
+  }
+
+  cprogress_render_tillcomplete(&cprogress, 30);
+
+  cprogress_destroy(&cprogress);
+  return 0;
+}
+
+
+
+/* test rate */
+
+
+void *rate_thread_worker(void *userdata) {
+  demo_threaddata_t *td = (demo_threaddata_t *) userdata;
+
+  /* each thread downloads at its own pace, the last one speeds up half way */
+  size_t total = 4 << 20, chunk = (td->thread_index + 1) << 12;
+  for (size_t done = 0; done < total; done += chunk) {
+    if (td->thread_index == 3 && done > total / 2) chunk = 32 << 10;
+    cprogress_updatethread_progress(td->cprogress, td->thread_index, done, total);
+    jl_millisleep(10);
+  }
+  cprogress_updatethread_progress(td->cprogress, td->thread_index, total, total); /* stops the thread */
+  return NULL;
+}
+
+int test_rate() {
+  cprogress_t cprogress = cprogress_create("$=t [$20b#] $p% $B $R eta $e, $T", 4);
+  if (cprogress.error) {
+    printf("error occured with code %d\n", cprogress.error);
+    return 1;
+  }
+
+  demo_threaddata_t threaddatas[4] = {};
+  for (int i = 0; i < 4; ++i) {
+    cprogress_startthread(&cprogress, i);
+    cprogress_updatethread_title(&cprogress, i, "Downloading");
+
+    threaddatas[i] = (demo_threaddata_t) { &cprogress, i };
+    jl_createthread(rate_thread_worker, &threaddatas[i], 0);
+  }
+
+  cprogress_render_tillcomplete(&cprogress, 30);
+
+  cprogress_destroy(&cprogress);
+  return 0;
+}
+
+
+
+
+/* test spinner */
+
+
+void *spinner_thread_worker(void *userdata) {
+  demo_threaddata_t *td = (demo_threaddata_t *) userdata;
+
+  /* no idea how many there are, count them as they come; thread 1 gets stuck for a while */
+  for (int i = 0; i < 300; ++i) {
+    if (td->thread_index == 1 && i == 100) jl_millisleep(4000);
+    if (td->thread_index == 0) cprogress_updatethread_progress(td->cprogress, td->thread_index, i, 0);
+    else cprogress_tickthread(td->cprogress, td->thread_index);
+    jl_millisleep(20);
+  }
+  cprogress_abortthread(td->cprogress, td->thread_index);
+  return NULL;
+}
+
+int test_spinner() {
+  cprogress_t cprogress = cprogress_create("$s $=t [$30b=] $c $r", 2);
+  if (cprogress.error) {
+    printf("error occured with code %d\n", cprogress.error);
+    return 1;
+  }
+
+  demo_threaddata_t threaddatas[2] = {};
+  const char *titles[2] = { "Walking directories", "Draining queue" };
+  for (int i = 0; i < 2; ++i) {
+    cprogress_startthread(&cprogress, i);
+    cprogress_updatethread_title(&cprogress, i, titles[i]);
+    cprogress_updatethread_indeterminate(&cprogress, i, 1);
+
+    threaddatas[i] = (demo_threaddata_t) { &cprogress, i };
+    jl_createthread(spinner_thread_worker, &threaddatas[i], 0);
+  }
+
+  cprogress_render_tillcomplete(&cprogress, 30);
+
+  cprogress_destroy(&cprogress);
+  return 0;
+}
+
+
+
+
+/* test formats */
+
+
+void *formats_thread_worker(void *userdata) {
+  demo_threaddata_t *td = (demo_threaddata_t *) userdata;
+
+  /* even ones download bytes, odd ones compute shards */
+  uint64_t total = td->thread_index % 2? 200: 6 << 20;
+  uint64_t step = td->thread_index % 2? 1: (td->thread_index + 1) << 14;
+  for (uint64_t done = 0; done < total; done += step) {
+    cprogress_updatethread_progress(td->cprogress, td->thread_index, done, total);
+    jl_millisleep(20);
+  }
+  cprogress_updatethread_progress(td->cprogress, td->thread_index, total, total); /* stops the thread */
+  return NULL;
+}
+
+int test_formats() {
+  /* parsed once, shared by both instances below */
+  cprogress_error_t error;
+  cprogress_format_t *downloads = cprogress_format_create("$=t [$20b#] $B $R", &error);
+  cprogress_format_t *shards = cprogress_format_create("$=t [$20b#] $c eta $e", &error);
+  if (!downloads || !shards) {
+    printf("error occured with code %d\n", error);
+    return 1;
+  }
+
+  for (int round = 0; round < 2; ++round) {
+    cprogress_t cprogress = cprogress_create_withformat(downloads, 4);
+    if (cprogress.error) {
+      printf("error occured with code %d\n", cprogress.error);
+      return 1;
+    }
+    int shards_index = cprogress_attachformat(&cprogress, shards);
+
+    demo_threaddata_t threaddatas[4] = {};
+    for (int i = 0; i < 4; ++i) {
+      cprogress_startthread(&cprogress, i);
+      cprogress_updatethread_title(&cprogress, i, i % 2? "Computing": "Downloading");
+      if (i % 2) cprogress_updatethread_format(&cprogress, i, shards_index);
+
+      threaddatas[i] = (demo_threaddata_t) { &cprogress, i };
+      jl_createthread(formats_thread_worker, &threaddatas[i], 0);
+    }
+
+    cprogress_render_tillcomplete(&cprogress, 30);
+
+    cprogress_destroy(&cprogress);
+  }
+
+  cprogress_format_release(downloads);
+  cprogress_format_release(shards);
+  return 0;
+}
+
+
+
+
+/* test allocator */
+
+
+typedef struct {
+  size_t alloc_count;
+  size_t live_size;
+} demo_allocstats_t;
+
+void *demo_alloc(size_t size, size_t align, void *userdata) {
+  demo_allocstats_t *stats = (demo_allocstats_t *) userdata;
+  __atomic_add_fetch(&stats->alloc_count, 1, __ATOMIC_RELAXED);
+  __atomic_add_fetch(&stats->live_size, size, __ATOMIC_RELAXED);
+  return aligned_alloc(align, (size + align - 1) & ~(align - 1));
+}
+
+void demo_free(void *ptr, size_t size, void *userdata) {
+  demo_allocstats_t *stats = (demo_allocstats_t *) userdata;
+  __atomic_sub_fetch(&stats->live_size, size, __ATOMIC_RELAXED);
+  free(ptr);
+}
+
+int test_allocator() {
+  demo_allocstats_t stats = {};
+  cprogress_allocator_t allocator = { demo_alloc, demo_free, &stats };
+
+  cprogress_t cprogress = cprogress_create_withallocator("$=t [$30b#] $c", 0, &allocator);
+  if (cprogress.error) {
+    printf("error occured with code %d\n", cprogress.error);
+    return 1;
+  }
+
+  /* more than the first segment holds, so the pool grows */
+  demo_threaddata_t threaddatas[20] = {};
+  for (int i = 0; i < 20; ++i) {
+    int thread_index = cprogress_acquire(&cprogress);
+    cprogress_updatethread_title(&cprogress, thread_index, "Worker");
+
+    threaddatas[i] = (demo_threaddata_t) { &cprogress, thread_index };
+    jl_createthread(formats_thread_worker, &threaddatas[i], 0);
+  }
+
+  cprogress_render_tillcomplete(&cprogress, 30);
+
+  cprogress_destroy(&cprogress);
+  printf("%zu allocations, %zu bytes left\n", stats.alloc_count, stats.live_size);
+  return stats.live_size != 0;
+}
+
+
+
+
+/* test stats */
+
+
+int test_stats() {
+  cprogress_t cprogress = cprogress_create("$=t [$20b#] $p% $B $R eta $e, $T", 4);
+  if (cprogress.error) {
+    printf("error occured with code %d\n", cprogress.error);
+    return 1;
+  }
+
+  demo_threaddata_t threaddatas[4] = {};
+  for (int i = 0; i < 4; ++i) {
+    cprogress_startthread(&cprogress, i);
+    cprogress_updatethread_title(&cprogress, i, "Downloading");
+
+    threaddatas[i] = (demo_threaddata_t) { &cprogress, i };
+    jl_createthread(rate_thread_worker, &threaddatas[i], 0);
+  }
+
+  cprogress_render_tillcomplete(&cprogress, 30);
+
+  cprogress_stats_t stats;
+  cprogress_stats(&cprogress, &stats);
+  printf("%llu frames, %llu skipped, %llu missed deadlines, %llu bytes in %llu writes, %d columns\n",
+    (unsigned long long) stats.frames_rendered, (unsigned long long) stats.frames_skipped,
+    (unsigned long long) stats.deadlines_missed, (unsigned long long) stats.bytes_written,
+    (unsigned long long) stats.write_calls, stats.console_width);
+  printf("frame time p50 %lluns, p90 %lluns, p99 %lluns, p99.9 %lluns, max %lluns\n",
+    (unsigned long long) stats.render_p50_ns, (unsigned long long) stats.render_p90_ns,
+    (unsigned long long) stats.render_p99_ns, (unsigned long long) stats.render_p999_ns,
+    (unsigned long long) stats.render_max_ns);
+  printf("rendering took %.3f%% of the time\n", stats.elapsed_ns? 100.0 * stats.render_ns / stats.elapsed_ns: 0);
+
+  cprogress_destroy(&cprogress);
+  return 0;
+}
+
+
+
+
+/* test trace */
+
+
+int test_trace() {
+  cprogress_t cprogress = cprogress_create("$=t [$40b#] $p%", 0);
+  if (cprogress.error || cprogress_enabletrace(&cprogress, 1 << 16)) {
+    printf("error occured with code %d\n", cprogress.error);
+    return 1;
+  }
+
+  /* the pool of test_pool(), as a timeline afterwards */
+  __atomic_store_n(&pool_workers_done, 0, __ATOMIC_RELAXED);
+  for (int i = 0; i < 8; ++i) {
+    jl_createthread(pool_thread_worker, &cprogress, 0);
+  }
+
+  while (__atomic_load_n(&pool_workers_done, __ATOMIC_ACQUIRE) < 8) {
+    cprogress_render(&cprogress);
+    cprogress_dispatchevents(&cprogress);
+    cprogress_waitfps(30);
+  }
+  cprogress_render(&cprogress);
+
+  cprogress_error_t error = cprogress_writetrace(&cprogress, "cprogress_trace.json");
+  if (error) printf("error occured with code %d\n", error);
+  else puts("open cprogress_trace.json in ui.perfetto.dev or chrome://tracing");
+
+  cprogress_destroy(&cprogress);
+  return error != CPROGRESS_ERROR_OK;
+}
+
+
+
+
+/* test shared */
+
+
+#define SHARED_WORKER_COUNT 4
+
+/* runs in its own process, straight on the shared slots */
+void shared_worker(cprogress_t *cprogress, int thread_index) {
+  for (int step = 0; step <= 50; ++step) {
+    /* one of them dies in the middle of an update, leaving the slot half written */
+    if (thread_index == 2 && step == 25) {
+      cprogress_threadinfo_writebegin(&cprogress_getthreadinfo(cprogress, thread_index));
+      raise(SIGKILL);
+    }
+    cprogress_updatethread_progress(cprogress, thread_index, step, 50);
+    jl_millisleep(40 + thread_index * 20);
+  }
+}
+
+int test_shared() {
+  cprogress_t cprogress = cprogress_create_shared("$=t [$40b#] $p%", SHARED_WORKER_COUNT);
+  if (cprogress.error) {
+    printf("error occured with code %d\n", cprogress.error);
+    return 1;
+  }
+
+  pid_t pids[SHARED_WORKER_COUNT];
+  for (int i = 0; i < SHARED_WORKER_COUNT; ++i) {
+    char title[64] = {};
+    snprintf(title, 63, "Worker process %d", i);
+    cprogress_startthread(&cprogress, i);
+    cprogress_updatethread_title(&cprogress, i, title);
+
+    fflush(stdout); /* or the child prints it again */
+    if (!(pids[i] = fork())) {
+      shared_worker(&cprogress, i);
+      _exit(0);
+    }
+  }
+
+  while (cprogress_stillrunning(&cprogress)) {
+    /* however a worker ended, its slot is done with */
+    int status;
+    pid_t pid;
+    while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+      for (int i = 0; i < SHARED_WORKER_COUNT; ++i) {
+        if (pids[i] == pid) cprogress_recoverthread(&cprogress, i);
+      }
+    }
+
+    cprogress_render(&cprogress);
+    cprogress_dispatchevents(&cprogress);
+    cprogress_waitfps(30);
+  }
+  cprogress_dispatchevents(&cprogress);
+
+  cprogress_destroy(&cprogress);
+  return 0;
+}
+
+
+
+
+/* test named */
+
+
+#define NAMED_WORKER_COUNT 4
+
+int named_workers_done = 0;
+
+void *named_thread_worker(void *userdata) {
+  demo_threaddata_t *td = (demo_threaddata_t *) userdata;
+
+  for (int step = 0; step <= 100; ++step) {
+    cprogress_updatethread_progress(td->cprogress, td->thread_index, step * td->thread_index, 100 * td->thread_index);
+    jl_millisleep(100 + td->thread_index * 30);
+  }
+  __atomic_fetch_add(&named_workers_done, 1, __ATOMIC_RELEASE);
+  return NULL;
+}
+
+/* nothing is rendered here, watch it from another shell with tools/cprogress-top */
+int test_named() {
+  cprogress_t cprogress = cprogress_create_named("$=t [$40b#] $p%", NAMED_WORKER_COUNT + 1, "/cprogress-demo");
+  if (cprogress.error) {
+    printf("error occured with code %d\n", cprogress.error);
+    return 1;
+  }
+  puts("running, see it with: cprogress-top /cprogress-demo");
+
+  cprogress_startthread(&cprogress, 0);
+  cprogress_updatethread_title(&cprogress, 0, "Downloads");
+
+  demo_threaddata_t threaddatas[NAMED_WORKER_COUNT] = {};
+  for (int i = 0; i < NAMED_WORKER_COUNT; ++i) {
+    char title[64] = {};
+    snprintf(title, 63, "File %d", i);
+    cprogress_startthread(&cprogress, i + 1);
+    cprogress_updatethread_title(&cprogress, i + 1, title);
+    cprogress_attachthread(&cprogress, i + 1, 0, 1);
+
+    threaddatas[i] = (demo_threaddata_t) { &cprogress, i + 1 };
+    jl_createthread(named_thread_worker, &threaddatas[i], 0);
+  }
+
+  while (__atomic_load_n(&named_workers_done, __ATOMIC_ACQUIRE) < NAMED_WORKER_COUNT) {
+    jl_millisleep(100);
+  }
+  cprogress_abortthread(&cprogress, 0);
+  jl_millisleep(500); /* for a viewer to take the last frame */
+
+  cprogress_destroy(&cprogress);
+  puts("done");
+  return 0;
+}
+
+
+
+
+/* test export */
+
+
+/* the downloads of test_rate(), for dashboards: the line on screen has no rate, the export does */
+int test_export() {
+  cprogress_t cprogress = cprogress_create("$=t [$40b#] $p%", 4);
+  if (cprogress.error) {
+    printf("error occured with code %d\n", cprogress.error);
+    return 1;
+  }
+
+  /* or CPROGRESS_EXPORT_PROMETHEUS into e.g. /var/lib/node_exporter/textfile/cprogress.prom */
+  cprogress_error_t error = cprogress_enableexport(&cprogress, CPROGRESS_EXPORT_JSONLINES, "cprogress_export.jsonl", 500);
+  if (error) {
+    printf("error occured with code %d\n", error);
+    return 1;
+  }
+
+  demo_threaddata_t threaddatas[4] = {};
+  for (int i = 0; i < 4; ++i) {
+    cprogress_startthread(&cprogress, i);
+    cprogress_updatethread_title(&cprogress, i, "Downloading");
+
+    threaddatas[i] = (demo_threaddata_t) { &cprogress, i };
+    jl_createthread(rate_thread_worker, &threaddatas[i], 0);
+  }
+
+  /* exports every 500ms of frames, and once more at the end */
+  cprogress_render_tillcomplete(&cprogress, 30);
+  puts("see cprogress_export.jsonl");
+
+  cprogress_destroy(&cprogress);
+  return 0;
+}
+
+
+
+
+/* test record */
+
+
+/* the pool of test_pool(), replay it with: cprogress-replay -s 4 cprogress_record.bin */
+int test_record() {
+  cprogress_t cprogress = cprogress_create("$=t [$30b#] $p% $c $r eta $e", 0);
+  if (cprogress.error) {
+    printf("error occured with code %d\n", cprogress.error);
+    return 1;
+  }
+  cprogress_error_t error = cprogress_enablerecord(&cprogress, "cprogress_record.bin");
+  if (error) {
+    printf("error occured with code %d\n", error);
+    return 1;
+  }
+
+  __atomic_store_n(&pool_workers_done, 0, __ATOMIC_RELAXED);
+  for (int i = 0; i < 8; ++i) {
+    jl_createthread(pool_thread_worker, &cprogress, 0);
+  }
+
+  while (__atomic_load_n(&pool_workers_done, __ATOMIC_ACQUIRE) < 8) {
+    cprogress_render(&cprogress);
+    cprogress_dispatchevents(&cprogress);
+    cprogress_waitfps(30);
+  }
+  cprogress_render(&cprogress);
+
+  /* the rest of the record is written out here */
+  cprogress_destroy(&cprogress);
+  puts("see cprogress_record.bin");
+  return 0;
+}
+
+
+
+
 /* switcher */
 
 
@@ -171,6 +837,19 @@ int main(void) {
 
   // return test_internal();
   // return test_usage();
+  // return test_local();
+  // return test_pool();
+  // return test_tree();
+  // return test_rate();
+  // return test_spinner();
+  // return test_formats();
+  // return test_allocator();
+  // return test_stats();
+  // return test_trace();
+  // return test_shared();
+  // return test_named();
+  // return test_export();
+  // return test_record();
   return demo();
 
   // return 0;
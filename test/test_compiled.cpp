@@ -0,0 +1,43 @@
+#include "cstdio"
+#include "cstring"
+
+#include "../cprogress.hpp"
+
+
+/* formats are checked by the compiler, uncomment any of these to see it fail */
+// static auto two_autospans = cprogress_compiledformat<"$=t $=p">::displaychunks;
+// static auto bar_without_width = cprogress_compiledformat<"$t [$b#]">::displaychunks;
+// static auto unknown_conversion = cprogress_compiledformat<"$t $x">::displaychunks;
+
+static_assert(cprogress_compiledformat<"$=t [$40b#] $p%">::length == 6);
+static_assert(cprogress_compiledformat<"$=t [$40b#] $p%">::displaychunks[2].type == CPROGRESS_DISPLAYCHUNK_BAR);
+static_assert(cprogress_compiledformat<"$=t [$40b#] $p%">::displaychunks[2].span_width == 40);
+
+
+/* compiled and parsed formats draw the same */
+int test_same() {
+  const char *title = "Simple task";
+  char compiled_line[256] = {}, parsed_line[256] = {};
+
+  cprogress_t compiled = cprogress_create_compiled<"$=t [$40b#] $p% $c">(1);
+  cprogress_t parsed = cprogress_create("$=t [$40b#] $p% $c", 1);
+  if (compiled.error || parsed.error) {
+    printf("error occured with code %d, %d\n", compiled.error, parsed.error);
+    return 1;
+  }
+
+  /* the chunk table made by the compiler, against the one of the parser */
+  cprogress_lineinfo_t lineinfo = cprogress_lineinfo_make(title, 31);
+  cprogress_writelineinfo(&compiled, compiled_line, 255, 80, &lineinfo);
+  cprogress_writelineinfo(&parsed, parsed_line, 255, 80, &lineinfo);
+  printf("compiled: [%s]\nparsed:   [%s]\n", compiled_line, parsed_line);
+
+  cprogress_destroy(&compiled);
+  cprogress_destroy(&parsed);
+  return strcmp(compiled_line, parsed_line) != 0;
+}
+
+
+int main(void) {
+  return test_same();
+}
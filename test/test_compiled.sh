@@ -0,0 +1,6 @@
+#!/bin/sh
+
+# the implementation stays in C, only the format is compiled by C++
+gcc -c -o cprogress.o -g -x c -DCPROGRESS_IMPL ../cprogress.h &&
+g++ -std=c++20 -o test_compiled -g test_compiled.cpp cprogress.o &&
+./test_compiled
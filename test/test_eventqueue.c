@@ -0,0 +1,92 @@
+#include "signal.h"
+#include "stdio.h"
+#include "unistd.h"
+
+#include "sys/wait.h"
+
+#define CPROGRESS_IMPL
+#include "../cprogress.h"
+#include "check.h"
+
+
+/*
+  a forked worker killed in the middle of queueing an event doesn't hold back the rest, and
+  one that was only slow doesn't write over a later event once its position was skipped
+*/
+
+
+#define EVENTQUEUE_STALE_INDEX 1000 /* no slot has it */
+
+int eventqueue_finish_count = 0;
+int eventqueue_stale_count = 0;
+
+void eventqueue_onfinish(cprogress_t *cprogress, cprogress_event_type_t type, int thread_index, void *userdata) {
+  (void) cprogress; (void) type; (void) userdata;
+  ++eventqueue_finish_count;
+  if (thread_index == EVENTQUEUE_STALE_INDEX) ++eventqueue_stale_count;
+}
+
+/* runs [body] in a child and waits for it */
+#define eventqueue_forked(body) { \
+    pid_t pid = fork(); \
+    if (!pid) { body; _exit(0); } \
+    waitpid(pid, NULL, 0); \
+  }
+
+int eventqueue_dispatch(cprogress_t *cprogress, int times) {
+  for (int i = 0; i < times; ++i) cprogress_dispatchevents(cprogress);
+  return eventqueue_finish_count;
+}
+
+int main(void) {
+  cprogress_t cprogress = cprogress_create_shared("$=t [$20b#] $p%", 2);
+  if (!check(!cprogress.error, "error occured with code %d", cprogress.error)) return 1;
+  cprogress_subscribeevent_userdata(&cprogress, CPROGRESS_EVENT_THREADFINISH, eventqueue_onfinish, NULL);
+  cprogress_startallthreads(&cprogress);
+  cprogress_eventqueue_t *eventqueue = cprogress.eventqueue;
+
+  /* the first half of cprogress_pushevent(...): the position is claimed, the cell never taken */
+  eventqueue_forked({
+    cprogress_eventqueue_claim(eventqueue);
+    raise(SIGKILL);
+  });
+  eventqueue_forked(cprogress_abortthread(&cprogress, 1));
+
+  /* held back, to keep the order, until the dead worker is known */
+  check(eventqueue_dispatch(&cprogress, CPROGRESS_EVENTQUEUE_MAXSTALL * 2) == 0, "event delivered past a position still claimed");
+
+  cprogress_recoverthread(&cprogress, 0);
+  check(eventqueue_dispatch(&cprogress, CPROGRESS_EVENTQUEUE_MAXSTALL) == 2,
+    "%d of 2 events delivered after recovering", eventqueue_finish_count);
+  check(eventqueue->dropped_count == 1, "%llu events dropped, 1 expected", (unsigned long long) eventqueue->dropped_count);
+
+  /* laps around the ring go on as before */
+  for (int i = 0; i < CPROGRESS_EVENTQUEUE_LENGTH * 3; ++i) {
+    eventqueue_forked({
+      cprogress_startthread(&cprogress, 1);
+      cprogress_abortthread(&cprogress, 1);
+    });
+    if (i % 64 == 63) cprogress_dispatchevents(&cprogress);
+  }
+  int expected_count = 2 + CPROGRESS_EVENTQUEUE_LENGTH * 3;
+  check(eventqueue_dispatch(&cprogress, 1) == expected_count,
+    "%d of %d events delivered over later laps", eventqueue_finish_count, expected_count);
+
+  /* a slow updater: its position is skipped, and its cell reused by the next lap before it writes */
+  uint64_t pos = cprogress_eventqueue_claim(eventqueue);
+  eventqueue_dispatch(&cprogress, CPROGRESS_EVENTQUEUE_MAXSTALL);
+  cprogress_recoverevents(eventqueue);
+  eventqueue_dispatch(&cprogress, CPROGRESS_EVENTQUEUE_MAXSTALL);
+  check(eventqueue->dropped_count == 2, "slow position not skipped");
+  for (int i = 0; i < CPROGRESS_EVENTQUEUE_LENGTH; ++i) {
+    check(!cprogress_pushevent(eventqueue, CPROGRESS_EVENT_THREADFINISH, 1), "event %d of the next lap dropped", i);
+  }
+  check(cprogress_eventqueue_fill(eventqueue, pos, CPROGRESS_EVENT_THREADFINISH, EVENTQUEUE_STALE_INDEX) != 0, "skipped position written");
+  expected_count += CPROGRESS_EVENTQUEUE_LENGTH;
+  check(eventqueue_dispatch(&cprogress, 1) == expected_count,
+    "%d of %d events delivered after a skipped position", eventqueue_finish_count, expected_count);
+  check(eventqueue_stale_count == 0, "%d events written over by a slow updater", eventqueue_stale_count);
+
+  cprogress_destroy(&cprogress);
+  return check_end("events delivered past a dead worker, none written over by a slow one");
+}
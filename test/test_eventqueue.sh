@@ -0,0 +1,5 @@
+#!/bin/sh
+
+# forked workers, one killed in the middle of queueing an event
+gcc -o test_eventqueue -g test_eventqueue.c -pthread &&
+./test_eventqueue
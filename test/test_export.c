@@ -0,0 +1,163 @@
+#include "stdio.h"
+#include "stdlib.h"
+#include "string.h"
+#include "time.h"
+#include "unistd.h"
+
+#define CPROGRESS_IMPL
+#include "../cprogress.h"
+#include "check.h"
+
+
+/* exports of a fixed run at fixed frame times, compared to what they must be */
+
+
+#define EXPORT_JSONLINES_PATH "test_export.jsonl"
+#define EXPORT_PROMETHEUS_PATH "test_export.prom"
+#define EXPORT_BASE_NS 1000000000ULL
+#define EXPORT_FILE_MAXLEN 16384
+
+const char *export_jsonlines_expected =
+  "{\"time\": T, \"export\": 0, \"slot\": 0, \"parent\": null, \"title\": \"copy \\\"a\\\"\\n\", \"state\": \"running\", \"percentage\": 0.00, \"done\": 0, \"total\": 1000, \"rate\": null, \"elapsed_s\": 0.000, \"eta_s\": null}\n"
+  "{\"time\": T, \"export\": 0, \"slot\": 1, \"parent\": null, \"title\": \"scan\", \"state\": \"running\", \"percentage\": 0.00, \"done\": 0, \"total\": 0, \"rate\": null, \"elapsed_s\": 0.000, \"eta_s\": null}\n"
+  "{\"time\": T, \"export\": 0, \"slot\": 2, \"parent\": null, \"title\": \"stage\", \"state\": \"running\", \"percentage\": 0.00, \"done\": 0, \"total\": 0, \"rate\": null, \"elapsed_s\": 0.000, \"eta_s\": null}\n"
+  "{\"time\": T, \"export\": 0, \"slot\": 3, \"parent\": 2, \"title\": \"shard\", \"state\": \"running\", \"percentage\": 0.00, \"done\": 0, \"total\": 0, \"rate\": null, \"elapsed_s\": 0.000, \"eta_s\": null}\n"
+  "{\"time\": T, \"export\": 1, \"slot\": 0, \"parent\": null, \"title\": \"copy \\\"a\\\"\\n\", \"state\": \"running\", \"percentage\": 50.00, \"done\": 500, \"total\": 1000, \"rate\": 250.000, \"elapsed_s\": 2.000, \"eta_s\": 2.000}\n"
+  "{\"time\": T, \"export\": 1, \"slot\": 1, \"parent\": null, \"title\": \"scan\", \"state\": \"running\", \"percentage\": 25.00, \"done\": 0, \"total\": 0, \"rate\": 12.500, \"elapsed_s\": 2.000, \"eta_s\": 6.000}\n"
+  "{\"time\": T, \"export\": 1, \"slot\": 2, \"parent\": null, \"title\": \"stage\", \"state\": \"running\", \"percentage\": 40.00, \"done\": 0, \"total\": 0, \"rate\": 20.000, \"elapsed_s\": 2.000, \"eta_s\": 3.000}\n"
+  "{\"time\": T, \"export\": 1, \"slot\": 3, \"parent\": 2, \"title\": \"shard\", \"state\": \"running\", \"percentage\": 40.00, \"done\": 0, \"total\": 0, \"rate\": 20.000, \"elapsed_s\": 2.000, \"eta_s\": 3.000}\n"
+  "{\"time\": T, \"export\": 2, \"slot\": 0, \"parent\": null, \"title\": \"copy \\\"a\\\"\\n\", \"state\": \"finished\", \"percentage\": 100.00, \"done\": 1000, \"total\": 1000, \"rate\": 250.000, \"elapsed_s\": 3.000, \"eta_s\": 0.000}\n"
+  "{\"time\": T, \"export\": 2, \"slot\": 1, \"parent\": null, \"title\": \"scan\", \"state\": \"aborted\", \"percentage\": 25.00, \"done\": 0, \"total\": 0, \"rate\": 12.500, \"elapsed_s\": 3.000, \"eta_s\": 0.000}\n"
+  "{\"time\": T, \"export\": 2, \"slot\": 2, \"parent\": null, \"title\": \"stage\", \"state\": \"running\", \"percentage\": 40.00, \"done\": 0, \"total\": 0, \"rate\": 15.000, \"elapsed_s\": 3.000, \"eta_s\": 4.000}\n"
+  "{\"time\": T, \"export\": 2, \"slot\": 3, \"parent\": 2, \"title\": \"shard\", \"state\": \"running\", \"percentage\": 40.00, \"done\": 0, \"total\": 0, \"rate\": 15.000, \"elapsed_s\": 3.000, \"eta_s\": 4.000}\n"
+  "{\"time\": T, \"export\": 3, \"slot\": 2, \"parent\": null, \"title\": \"stage\", \"state\": \"running\", \"percentage\": 40.00, \"done\": 0, \"total\": 0, \"rate\": 11.250, \"elapsed_s\": 4.000, \"eta_s\": 5.333}\n"
+  "{\"time\": T, \"export\": 3, \"slot\": 3, \"parent\": 2, \"title\": \"shard\", \"state\": \"running\", \"percentage\": 40.00, \"done\": 0, \"total\": 0, \"rate\": 11.250, \"elapsed_s\": 4.000, \"eta_s\": 5.333}\n";
+
+const char *export_prometheus_expected =
+  "# HELP cprogress_slot_info Slot title, parent and state, always 1.\n"
+  "# TYPE cprogress_slot_info gauge\n"
+  "cprogress_slot_info{slot=\"0\",parent=\"\",title=\"copy \\\"a\\\"\\n\",state=\"finished\"} 1\n"
+  "cprogress_slot_info{slot=\"1\",parent=\"\",title=\"scan\",state=\"aborted\"} 1\n"
+  "cprogress_slot_info{slot=\"2\",parent=\"\",title=\"stage\",state=\"running\"} 1\n"
+  "cprogress_slot_info{slot=\"3\",parent=\"2\",title=\"shard\",state=\"running\"} 1\n"
+  "# HELP cprogress_running 1 while the slot runs.\n"
+  "# TYPE cprogress_running gauge\n"
+  "cprogress_running{slot=\"0\"} 0\n"
+  "cprogress_running{slot=\"1\"} 0\n"
+  "cprogress_running{slot=\"2\"} 1\n"
+  "cprogress_running{slot=\"3\"} 1\n"
+  "# HELP cprogress_percentage Progress in percent, rolled up for a parent.\n"
+  "# TYPE cprogress_percentage gauge\n"
+  "cprogress_percentage{slot=\"0\"} 100.00\n"
+  "cprogress_percentage{slot=\"1\"} 25.00\n"
+  "cprogress_percentage{slot=\"2\"} 40.00\n"
+  "cprogress_percentage{slot=\"3\"} 40.00\n"
+  "# HELP cprogress_done Items done, when updated with counts.\n"
+  "# TYPE cprogress_done gauge\n"
+  "cprogress_done{slot=\"0\"} 1000\n"
+  "# HELP cprogress_total Items in total, when known.\n"
+  "# TYPE cprogress_total gauge\n"
+  "cprogress_total{slot=\"0\"} 1000\n"
+  "# HELP cprogress_rate Per second, in done when counted or else in percent.\n"
+  "# TYPE cprogress_rate gauge\n"
+  "cprogress_rate{slot=\"0\"} 250.000\n"
+  "cprogress_rate{slot=\"1\"} 12.500\n"
+  "cprogress_rate{slot=\"2\"} 11.250\n"
+  "cprogress_rate{slot=\"3\"} 11.250\n"
+  "# HELP cprogress_elapsed_seconds Since the slot started.\n"
+  "# TYPE cprogress_elapsed_seconds gauge\n"
+  "cprogress_elapsed_seconds{slot=\"0\"} 3.000\n"
+  "cprogress_elapsed_seconds{slot=\"1\"} 3.000\n"
+  "cprogress_elapsed_seconds{slot=\"2\"} 4.000\n"
+  "cprogress_elapsed_seconds{slot=\"3\"} 4.000\n"
+  "# HELP cprogress_eta_seconds Estimated time left.\n"
+  "# TYPE cprogress_eta_seconds gauge\n"
+  "cprogress_eta_seconds{slot=\"0\"} 0.000\n"
+  "cprogress_eta_seconds{slot=\"1\"} 0.000\n"
+  "cprogress_eta_seconds{slot=\"2\"} 5.333\n"
+  "cprogress_eta_seconds{slot=\"3\"} 5.333\n"
+  "# HELP cprogress_export_timestamp_seconds When this was written.\n"
+  "# TYPE cprogress_export_timestamp_seconds gauge\n"
+  "cprogress_export_timestamp_seconds T\n";
+
+double export_getwalltime() {
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* the one thing taken from the wall clock, replaced by T once it is within [begin, end] */
+int export_normalize(char *buf, const char *key, double begin, double end) {
+  size_t key_length = strlen(key);
+  for (char *found = strstr(buf, key); found; found = strstr(found, key)) {
+    char *value = found + key_length, *value_end;
+    double time = strtod(value, &value_end);
+    if (!check(value_end != value && time >= begin - 0.001 && time <= end + 0.001,
+      "%s%.*s not between %.3f and %.3f", key, (int) (value_end - value), value, begin, end)) return 0;
+    *value = 'T';
+    memmove(value + 1, value_end, strlen(value_end) + 1);
+    found = value;
+  }
+  return 1;
+}
+
+void export_check(const char *path, const char *key, const char *expected, double begin, double end) {
+  static char buf[EXPORT_FILE_MAXLEN];
+  FILE *file = fopen(path, "r");
+  size_t length = file? fread(buf, 1, sizeof(buf) - 1, file): 0;
+  if (file) fclose(file);
+  buf[length] = 0;
+  unlink(path);
+
+  if (!export_normalize(buf, key, begin, end)) return;
+  check(!strcmp(buf, expected), "%s differs, written:\n%s\nexpected:\n%s", path, buf, expected);
+}
+
+/* the same run for either type, exported at 0, 2, 3 and 4 seconds of frame time; Prometheus keeps the last */
+void export_run(cprogress_export_type_t type, const char *path) {
+  unlink(path);
+  cprogress_t cprogress = check_create("$=t [$20b#] $p%", 4);
+  if (!check(cprogress_enableexport(&cprogress, type, path, 0) == CPROGRESS_ERROR_OK, "%s not exported to", path)) {
+    cprogress_destroy(&cprogress);
+    return;
+  }
+
+  cprogress_startallthreads(&cprogress);
+  cprogress_updatethread_title(&cprogress, 0, "copy \"a\"\n");
+  cprogress_updatethread_progress(&cprogress, 0, 0, 1000);
+  cprogress_updatethread_title(&cprogress, 1, "scan");
+  cprogress_updatethread_title(&cprogress, 2, "stage");
+  cprogress_updatethread_title(&cprogress, 3, "shard");
+  cprogress_attachthread(&cprogress, 3, 2, 1);
+  cprogress.frame.now_ns = EXPORT_BASE_NS;
+  cprogress_exportframe(&cprogress);
+
+  cprogress_updatethread_progress(&cprogress, 0, 500, 1000);
+  cprogress_updatethread_percentage(&cprogress, 1, 25);
+  cprogress_updatethread_percentage(&cprogress, 3, 40);
+  cprogress.frame.now_ns = EXPORT_BASE_NS + 2000000000ULL;
+  cprogress_exportframe(&cprogress);
+
+  cprogress_updatethread_progress(&cprogress, 0, 1000, 1000);
+  cprogress_abortthread(&cprogress, 1);
+  cprogress.frame.now_ns = EXPORT_BASE_NS + 3000000000ULL;
+  cprogress_exportframe(&cprogress);
+
+  /* stopped slots are not in JSON Lines again, rates of stalled ones fall off over CPROGRESS_RATE_TAU_MS */
+  cprogress.frame.now_ns = EXPORT_BASE_NS + 4000000000ULL;
+  check(cprogress_exportframe(&cprogress) == CPROGRESS_ERROR_OK, "%s not exported to at 4 seconds", path);
+  cprogress_destroy(&cprogress);
+}
+
+int main(void) {
+  double begin = export_getwalltime();
+  export_run(CPROGRESS_EXPORT_JSONLINES, EXPORT_JSONLINES_PATH);
+  export_check(EXPORT_JSONLINES_PATH, "\"time\": ", export_jsonlines_expected, begin, export_getwalltime());
+
+  begin = export_getwalltime();
+  export_run(CPROGRESS_EXPORT_PROMETHEUS, EXPORT_PROMETHEUS_PATH);
+  export_check(EXPORT_PROMETHEUS_PATH, "\ncprogress_export_timestamp_seconds ", export_prometheus_expected,
+    begin, export_getwalltime());
+
+  return check_end("exports as expected");
+}
@@ -0,0 +1,5 @@
+#!/bin/sh
+
+# JSON Lines and Prometheus of a fixed run, compared to golden output
+gcc -o test_export -g test_export.c -pthread &&
+./test_export
@@ -0,0 +1,169 @@
+#include "stdio.h"
+#include "stdlib.h"
+#include "string.h"
+#include "errno.h"
+#include "unistd.h"
+
+
+/* every allocation goes through here, counted while rendering */
+
+
+extern void *__libc_malloc(size_t);
+extern void *__libc_calloc(size_t, size_t);
+extern void *__libc_realloc(void *, size_t);
+extern void *__libc_memalign(size_t, size_t);
+extern void __libc_free(void *);
+
+int noalloc_is_armed = 0;
+size_t noalloc_alloc_count = 0;
+
+/* no stdio here, it may allocate itself */
+void noalloc_check(const char *name) {
+  if (!__atomic_load_n(&noalloc_is_armed, __ATOMIC_RELAXED)) return;
+
+  __atomic_add_fetch(&noalloc_alloc_count, 1, __ATOMIC_RELAXED);
+  write(STDERR_FILENO, name, strlen(name));
+  write(STDERR_FILENO, " while rendering\n", 17);
+}
+
+void *malloc(size_t size) {
+  noalloc_check("malloc");
+  return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size) {
+  noalloc_check("calloc");
+  return __libc_calloc(count, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+  noalloc_check("realloc");
+  return __libc_realloc(ptr, size);
+}
+
+void *memalign(size_t align, size_t size) {
+  noalloc_check("memalign");
+  return __libc_memalign(align, size);
+}
+
+void *aligned_alloc(size_t align, size_t size) {
+  noalloc_check("aligned_alloc");
+  return __libc_memalign(align, size);
+}
+
+int posix_memalign(void **ptr, size_t align, size_t size) {
+  noalloc_check("posix_memalign");
+  *ptr = __libc_memalign(align, size);
+  return *ptr? 0: ENOMEM;
+}
+
+void free(void *ptr) {
+  __libc_free(ptr);
+}
+
+
+/* the workload of test.c */
+
+
+#define main test_main
+#include "test.c"
+#undef main
+
+/* as cprogress_render_tillcomplete(...), only armed once the first frames are out */
+void noalloc_render(cprogress_t *cprogress, int *workers_done, int workers_length) {
+  for (int frame = 0; ; ++frame) {
+    if (frame == 2) __atomic_store_n(&noalloc_is_armed, 1, __ATOMIC_RELAXED);
+
+    int is_running = workers_done?
+      __atomic_load_n(workers_done, __ATOMIC_ACQUIRE) < workers_length:
+      cprogress_stillrunning(cprogress);
+    if (!is_running) break;
+
+    cprogress_render(cprogress);
+    cprogress_dispatchevents(cprogress);
+    cprogress_waitfps(30);
+  }
+  cprogress_render(cprogress);
+  cprogress_dispatchevents(cprogress);
+
+  __atomic_store_n(&noalloc_is_armed, 0, __ATOMIC_RELAXED);
+}
+
+void noalloc_rate() {
+  cprogress_t cprogress = cprogress_create("$=t [$20b#] $p% $B $R eta $e, $T", 4);
+
+  demo_threaddata_t threaddatas[4] = {};
+  for (int i = 0; i < 4; ++i) {
+    cprogress_startthread(&cprogress, i);
+    cprogress_updatethread_title(&cprogress, i, "Downloading");
+
+    threaddatas[i] = (demo_threaddata_t) { &cprogress, i };
+    jl_createthread(rate_thread_worker, &threaddatas[i], 0);
+  }
+
+  noalloc_render(&cprogress, NULL, 0);
+  cprogress_destroy(&cprogress);
+}
+
+void noalloc_spinner() {
+  cprogress_t cprogress = cprogress_create("$s $=t [$30b=] $c $r", 2);
+
+  demo_threaddata_t threaddatas[2] = {};
+  for (int i = 0; i < 2; ++i) {
+    cprogress_startthread(&cprogress, i);
+    cprogress_updatethread_title(&cprogress, i, "Walking directories");
+    cprogress_updatethread_indeterminate(&cprogress, i, 1);
+
+    threaddatas[i] = (demo_threaddata_t) { &cprogress, i };
+    jl_createthread(spinner_thread_worker, &threaddatas[i], 0);
+  }
+
+  noalloc_render(&cprogress, NULL, 0);
+  cprogress_destroy(&cprogress);
+}
+
+void noalloc_formats() {
+  cprogress_format_t *shards = cprogress_format_create("$=t [$20b#] $c eta $e", NULL);
+  cprogress_t cprogress = cprogress_create("$=t [$20b#] $B $R", 4);
+  int shards_index = cprogress_attachformat(&cprogress, shards);
+  cprogress_format_release(shards);
+
+  demo_threaddata_t threaddatas[4] = {};
+  for (int i = 0; i < 4; ++i) {
+    cprogress_startthread(&cprogress, i);
+    cprogress_updatethread_title(&cprogress, i, i % 2? "Computing": "Downloading");
+    if (i % 2) cprogress_updatethread_format(&cprogress, i, shards_index);
+
+    threaddatas[i] = (demo_threaddata_t) { &cprogress, i };
+    jl_createthread(formats_thread_worker, &threaddatas[i], 0);
+  }
+
+  noalloc_render(&cprogress, NULL, 0);
+  cprogress_destroy(&cprogress);
+}
+
+/* tasks come and go while rendering, fewer at once than the first segment holds */
+void noalloc_pool() {
+  cprogress_t cprogress = cprogress_create("$=t [$40b#] $p%", 0);
+
+  for (int i = 0; i < 8; ++i) {
+    jl_createthread(pool_thread_worker, &cprogress, 0);
+  }
+
+  noalloc_render(&cprogress, &pool_workers_done, 8);
+  cprogress_destroy(&cprogress);
+}
+
+int main(void) {
+  noalloc_rate();
+  noalloc_spinner();
+  noalloc_formats();
+  noalloc_pool();
+
+  if (noalloc_alloc_count) {
+    fprintf(stderr, "%zu allocations while rendering\n", noalloc_alloc_count);
+    return 1;
+  }
+  fprintf(stderr, "no allocation while rendering\n");
+  return 0;
+}
@@ -0,0 +1,5 @@
+#!/bin/sh
+
+# the test.c workload, failing on any allocation once rendering has started
+gcc -o test_noalloc -g test_noalloc.c -pthread &&
+./test_noalloc
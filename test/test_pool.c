@@ -0,0 +1,122 @@
+#include "stdio.h"
+#include "stdlib.h"
+#include "unistd.h"
+
+#include "pthread.h"
+
+/* small first segments, so that one acquirer stalled in growing can be overtaken */
+#define CPROGRESS_THREADINFO_SEGMENT_MINLEN 1
+#define CPROGRESS_IMPL
+#include "../cprogress.h"
+#include "check.h"
+
+
+/*
+  thread_index handed out by the pool belongs to one holder at a time, and all come back;
+  while the pool grows, every index below threadinfos_length can be used
+*/
+
+
+#define POOL_THREAD_COUNT 8
+#define POOL_ROUND_COUNT 20000
+#define POOL_INDEX_MAXLEN 1024
+#define POOL_GROW_LENGTH 20000 /* acquired and kept, over a dozen segments */
+
+cprogress_t pool_cprogress;
+int pool_holders[POOL_INDEX_MAXLEN];
+int pool_is_growing;
+
+void *pool_worker(void *arg) {
+  int holder = (int) (intptr_t) arg + 1;
+  for (int i = 0; i < POOL_ROUND_COUNT; ++i) {
+    int thread_index = cprogress_acquire(&pool_cprogress);
+    if (!check(thread_index >= 0 && thread_index < POOL_INDEX_MAXLEN, "thread_index %d out of range", thread_index))
+      return NULL;
+
+    int other = __atomic_exchange_n(&pool_holders[thread_index], holder, __ATOMIC_ACQ_REL);
+    check(!other, "thread_index %d handed out to %d while %d holds it", thread_index, holder, other);
+    cprogress_updatethread_percentage(&pool_cprogress, thread_index, i % 100);
+    if (i % 7 == 0) sched_yield();
+    __atomic_store_n(&pool_holders[thread_index], 0, __ATOMIC_RELEASE);
+
+    cprogress_release(&pool_cprogress, thread_index);
+  }
+  return NULL;
+}
+
+void *pool_grower(void *arg) {
+  (void) arg;
+  for (int i = 0; i < POOL_GROW_LENGTH / POOL_THREAD_COUNT; ++i) {
+    int thread_index = cprogress_acquire(&pool_cprogress);
+    check(thread_index >= 0, "out of thread_index while growing");
+  }
+  return NULL;
+}
+
+/* segments take a while to come, so that acquirers of later ones overtake */
+void *pool_slowalloc(size_t size, size_t align, void *userdata) {
+  (void) userdata;
+  unsigned seed = (unsigned) (uintptr_t) &size;
+  usleep(rand_r(&seed) % 200);
+  void *ptr = NULL;
+  return posix_memalign(&ptr, align, size)? NULL: ptr;
+}
+
+void pool_slowfree(void *ptr, size_t size, void *userdata) {
+  (void) size; (void) userdata;
+  free(ptr);
+}
+
+/* the renderer's view: anything below the length is there, even while segments are installed */
+void *pool_reader(void *arg) {
+  cprogress_t *cprogress = (cprogress_t *) arg;
+  while (__atomic_load_n(&pool_is_growing, __ATOMIC_ACQUIRE)) {
+    size_t length = cprogress_getthreadinfos_length(cprogress);
+    for (size_t i = length > 64? length - 64: 0; i < length; ++i) {
+      cprogress_threadinfo_t *threadinfo = cprogress_threadinfo_at(cprogress, i);
+      if (!check(threadinfo && threadinfo->thread_index == i, "thread_index %zu below length %zu not there", i, length))
+        return NULL;
+      cprogress_collapsethread(cprogress, i, 0);
+    }
+  }
+  return NULL;
+}
+
+int main(void) {
+  pool_cprogress = check_create("$=t [$20b#] $p%", 1);
+
+  pthread_t threads[POOL_THREAD_COUNT + 1];
+  for (int i = 0; i < POOL_THREAD_COUNT; ++i) pthread_create(&threads[i], NULL, pool_worker, (void *) (intptr_t) i);
+  for (int i = 0; i < POOL_THREAD_COUNT; ++i) pthread_join(threads[i], NULL);
+
+  /* never more than one per holder at a time, plus the one from cprogress_create(...) */
+  size_t length = cprogress_getthreadinfos_length(&pool_cprogress);
+  check(length <= 1 + POOL_THREAD_COUNT, "%zu slots for %d holders", length, POOL_THREAD_COUNT);
+
+  /* every released one is on the free list, once */
+  for (size_t i = 1; i < length && i < POOL_INDEX_MAXLEN; ++i) {
+    int thread_index = cprogress_acquire(&pool_cprogress);
+    if (!check(thread_index > 0 && thread_index < length && !pool_holders[thread_index],
+      "thread_index %d from the free list, 1 to %zu each once expected", thread_index, length - 1)) break;
+    pool_holders[thread_index] = -1;
+  }
+  check(cprogress_getthreadinfos_length(&pool_cprogress) == length,
+    "grew to %zu while %zu - 1 were free", cprogress_getthreadinfos_length(&pool_cprogress), length);
+  cprogress_destroy(&pool_cprogress);
+
+  /* growing from one slot, segment by segment, with many acquirers racing for them */
+  for (int round = 0; round < 20; ++round) {
+    const cprogress_allocator_t allocator = { pool_slowalloc, pool_slowfree, NULL };
+    pool_cprogress = cprogress_create_withallocator("$=t [$20b#] $p%", 1, &allocator);
+    check(!pool_cprogress.error, "error occured with code %d", pool_cprogress.error);
+    __atomic_store_n(&pool_is_growing, 1, __ATOMIC_RELEASE);
+    pthread_create(&threads[POOL_THREAD_COUNT], NULL, pool_reader, &pool_cprogress);
+    for (int i = 0; i < POOL_THREAD_COUNT; ++i) pthread_create(&threads[i], NULL, pool_grower, NULL);
+    for (int i = 0; i < POOL_THREAD_COUNT; ++i) pthread_join(threads[i], NULL);
+    __atomic_store_n(&pool_is_growing, 0, __ATOMIC_RELEASE);
+    pthread_join(threads[POOL_THREAD_COUNT], NULL);
+    cprogress_destroy(&pool_cprogress);
+  }
+
+  return check_end("no thread_index handed out twice, none below the length missing");
+}
@@ -0,0 +1,5 @@
+#!/bin/sh
+
+# threads acquiring and releasing thread_index all at once
+gcc -o test_pool -g test_pool.c -pthread &&
+./test_pool
@@ -0,0 +1,140 @@
+#include "math.h"
+#include "stdio.h"
+#include "stdlib.h"
+#include "string.h"
+#include "unistd.h"
+
+/* the reader of cprogress-replay, without its main */
+#define main replay_main
+#include "../tools/cprogress-replay.c"
+#undef main
+#include "check.h"
+
+
+/* a known run is recorded, replayed frame by frame and every slot compared to what it was */
+
+
+#define RECORD_THREAD_COUNT 4
+#define RECORD_FRAME_MAXLEN 16
+#define RECORD_PATH "test_record.rec"
+/* a step only moves by whole 1 / CPROGRESS_RECORD_STEPS */
+#define RECORD_EPSILON (100.0 / CPROGRESS_RECORD_STEPS + 1e-3)
+
+cprogress_threadsnapshot_t record_expected[RECORD_FRAME_MAXLEN][RECORD_THREAD_COUNT];
+int record_frame_count = 0;
+
+/* renders one frame, which records what changed, and keeps the slots as they are now */
+void record_frame(cprogress_t *cprogress) {
+  cprogress_render(cprogress);
+  for (int i = 0; i < RECORD_THREAD_COUNT; ++i)
+    cprogress_threadinfo_snapshot(&cprogress_getthreadinfo(cprogress, i), &record_expected[record_frame_count][i]);
+  ++record_frame_count;
+}
+
+void record_compare(int frame, int thread_index, const cprogress_threadsnapshot_t *expected, const cprogress_threadsnapshot_t *actual) {
+  const char *field = NULL;
+  if (actual->is_running != expected->is_running) field = "is_running";
+  else if (actual->start_count != expected->start_count) field = "start_count";
+  else if (strcmp(actual->title, expected->title)) field = "title";
+  else if (actual->done != expected->done) field = "done";
+  else if (actual->total != expected->total) field = "total";
+  else if (actual->is_indeterminate != expected->is_indeterminate) field = "is_indeterminate";
+  else if (actual->format_index != expected->format_index) field = "format_index";
+  else if (actual->is_parent != expected->is_parent) field = "is_parent";
+  else if (fabs(actual->percentage - expected->percentage) > RECORD_EPSILON) field = "percentage";
+
+  check(!field, "frame %d, thread %d: %s differs, \"%s\" %llu/%llu %f%% replayed as \"%s\" %llu/%llu %f%%",
+    frame, thread_index, field, expected->title, (unsigned long long) expected->done, (unsigned long long) expected->total,
+    expected->percentage, actual->title, (unsigned long long) actual->done, (unsigned long long) actual->total,
+    actual->percentage);
+}
+
+/* each frame changes something, so that there is one in the record for every one rendered */
+int record_run(void) {
+  cprogress_t cprogress = check_create("$=t [$20b#] $p%", RECORD_THREAD_COUNT);
+  cprogress_error_t error;
+  cprogress_format_t *format = cprogress_format_create("$t: $c $40b=", &error);
+  if (!check(format && cprogress_attachformat(&cprogress, format) == 1, "format not attached, error %d", error))
+    return 0;
+  cprogress_format_release(format);
+  if (!check(cprogress_enablerecord(&cprogress, RECORD_PATH) == CPROGRESS_ERROR_OK, "%s not recorded to", RECORD_PATH))
+    return 0;
+
+  cprogress_startallthreads(&cprogress);
+  cprogress_updatethread_title(&cprogress, 0, "download");
+  cprogress_updatethread_progress(&cprogress, 0, 10, 200);
+  cprogress_updatethread_title(&cprogress, 1, "scan");
+  cprogress_updatethread_indeterminate(&cprogress, 1, 1);
+  cprogress_updatethread_progress(&cprogress, 1, 5000, 0);
+  cprogress_updatethread_percentage(&cprogress, 2, 12.5);
+  cprogress_updatethread_format(&cprogress, 2, 1);
+  cprogress_updatethread_title(&cprogress, 3, "tab\tand \"quote\"");
+  cprogress_updatethread_percentage(&cprogress, 3, 50);
+  record_frame(&cprogress);
+
+  cprogress_updatethread_progress(&cprogress, 0, 150, 200);
+  cprogress_updatethread_progress(&cprogress, 1, 9000, 0);
+  cprogress_updatethread_percentage(&cprogress, 2, 37.25);
+  record_frame(&cprogress);
+
+  cprogress_attachthread(&cprogress, 2, 3, 2);
+  cprogress_updatethread_percentage(&cprogress, 2, 60);
+  cprogress_updatethread_indeterminate(&cprogress, 1, 0);
+  cprogress_updatethread_percentage(&cprogress, 1, 20);
+  record_frame(&cprogress);
+
+  cprogress_updatethread_progress(&cprogress, 0, 200, 200);
+  cprogress_updatethread_format(&cprogress, 2, 0);
+  cprogress_updatethread_title(&cprogress, 3, "renamed");
+  record_frame(&cprogress);
+
+  cprogress_startthread(&cprogress, 0);
+  cprogress_updatethread_title(&cprogress, 0, "again");
+  cprogress_updatethread_progress(&cprogress, 0, 1, 3);
+  cprogress_detachthread(&cprogress, 2);
+  record_frame(&cprogress);
+
+  cprogress_abortthread(&cprogress, 1);
+  cprogress_updatethread_percentage(&cprogress, 2, 100);
+  record_frame(&cprogress);
+
+  cprogress_startthread(&cprogress, 1);
+  record_frame(&cprogress);
+
+  cprogress_destroy(&cprogress);
+  return 1;
+}
+
+int main(void) {
+  /* frames drawn while recording are of no interest */
+  if (!freopen("/dev/null", "w", stdout)) return 1;
+  if (!record_run()) return 1;
+
+  replay_t rp = {};
+  if (!check(replay_load(&rp, RECORD_PATH) && replay_readheader(&rp), "%s not read back", RECORD_PATH)) return 1;
+  check(rp.formats_length == 2, "%zu formats in the header, 2 expected", rp.formats_length);
+
+  rp.max_index = RECORD_THREAD_COUNT - 1;
+  rp.slots = (replay_slot_t *) calloc(RECORD_THREAD_COUNT, sizeof(replay_slot_t));
+  rp.cprogress = cprogress_create_withchunks(rp.displaychunks, RECORD_THREAD_COUNT);
+  for (size_t k = 1; k < rp.formats_length; ++k) cprogress_attachformat(&rp.cprogress, &rp.formats[k]);
+
+  int frame = 0;
+  for (; frame < record_frame_count && replay_readframe(&rp, &rp.cprogress); ++frame) {
+    for (int i = 0; i < RECORD_THREAD_COUNT; ++i) {
+      cprogress_threadsnapshot_t actual;
+      cprogress_threadinfo_snapshot(&cprogress_getthreadinfo(&rp.cprogress, i), &actual);
+      record_compare(frame, i, &record_expected[frame][i], &actual);
+    }
+  }
+  check(frame == record_frame_count && !replay_readframe(&rp, NULL),
+    "%d frames replayed, %d recorded", frame + (rp.cursor < rp.end), record_frame_count);
+
+  cprogress_destroy(&rp.cprogress);
+  free(rp.slots);
+  free(rp.formats);
+  free(rp.displaychunks);
+  free((void *) rp.begin);
+  unlink(RECORD_PATH);
+  return check_end("replayed as recorded");
+}
@@ -0,0 +1,5 @@
+#!/bin/sh
+
+# a known run recorded, replayed and compared frame by frame
+gcc -o test_record -g test_record.c -pthread -lm &&
+./test_record
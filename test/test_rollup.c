@@ -0,0 +1,121 @@
+#include "math.h"
+#include "stdio.h"
+
+#include "pthread.h"
+
+#define CPROGRESS_IMPL
+#include "../cprogress.h"
+#include "check.h"
+
+
+/*
+  a parent shows the weighted progress of its children:
+    0 job
+      1 stage, weight 1
+      2 stage, weight 2
+      3 stage, weight 3
+        4 shard, weight 1
+        5 shard, weight 3
+*/
+
+
+#define ROLLUP_THREAD_COUNT 6
+#define ROLLUP_ROUND_COUNT 100000
+/* one step of CPROGRESS_ROLLUP_SCALE lost per level at most */
+#define ROLLUP_EPSILON (2 * 100.0 / CPROGRESS_ROLLUP_SCALE)
+
+cprogress_t rollup_cprogress;
+const int rollup_parents[ROLLUP_THREAD_COUNT] = { CPROGRESS_UNDEF, 0, 0, 0, 3, 3 };
+const uint32_t rollup_weights[ROLLUP_THREAD_COUNT] = { 0, 1, 2, 3, 1, 3 };
+float rollup_percentages[ROLLUP_THREAD_COUNT];
+int rollup_is_attached[ROLLUP_THREAD_COUNT];
+
+float rollup_getpercentage(int thread_index) {
+  cprogress_threadsnapshot_t snapshot;
+  cprogress_threadinfo_snapshot(&cprogress_getthreadinfo(&rollup_cprogress, thread_index), &snapshot);
+  return snapshot.percentage;
+}
+
+/* what the parent should show, from the percentages set on the leaves */
+double rollup_expect(int thread_index) {
+  double sum = 0;
+  uint32_t weight_total = 0;
+  for (int i = 0; i < ROLLUP_THREAD_COUNT; ++i) {
+    if (!rollup_is_attached[i] || rollup_parents[i] != thread_index) continue;
+    sum += rollup_weights[i] * rollup_expect(i);
+    weight_total += rollup_weights[i];
+  }
+  return weight_total? sum / weight_total: rollup_percentages[thread_index];
+}
+
+void rollup_check(const char *when) {
+  for (int i = 0; i < ROLLUP_THREAD_COUNT; ++i) {
+    double expected = rollup_expect(i);
+    float percentage = rollup_getpercentage(i);
+    check(fabs(percentage - expected) <= ROLLUP_EPSILON, "%s: thread %d at %f%%, %f%% expected", when, i, percentage, expected);
+  }
+}
+
+void rollup_update(int thread_index, uint64_t done, uint64_t total) {
+  cprogress_updatethread_progress(&rollup_cprogress, thread_index, done, total);
+  rollup_percentages[thread_index] = done >= total? 100: done * 100.0 / total;
+}
+
+void *rollup_worker(void *arg) {
+  int thread_index = (int) (intptr_t) arg;
+  uint64_t total = ROLLUP_ROUND_COUNT + thread_index;
+  for (uint64_t done = 0; done < ROLLUP_ROUND_COUNT; ++done) {
+    cprogress_updatethread_progress(&rollup_cprogress, thread_index, done * 7919 % total, total);
+  }
+  rollup_update(thread_index, thread_index * 1000, total);
+  return NULL;
+}
+
+int main(void) {
+  rollup_cprogress = check_create("$=t [$20b#] $p%", ROLLUP_THREAD_COUNT);
+  cprogress_startallthreads(&rollup_cprogress);
+
+  rollup_update(2, 30, 100);
+  rollup_update(5, 1, 3);
+  for (int i = 1; i < ROLLUP_THREAD_COUNT; ++i) {
+    check(cprogress_attachthread(&rollup_cprogress, i, rollup_parents[i], rollup_weights[i]) == CPROGRESS_ERROR_OK,
+      "thread %d not attached", i);
+    rollup_is_attached[i] = 1;
+    rollup_check("attaching");
+  }
+  check(cprogress_attachthread(&rollup_cprogress, 0, 4, 1) == CPROGRESS_ERROR_INVAL, "cycle accepted");
+
+  rollup_update(1, 50, 100);
+  rollup_update(4, 1, 4);
+  rollup_update(5, 6, 7);
+  rollup_check("updating");
+
+  /* the parent's own percentage only counts once it has no children */
+  rollup_update(3, 90, 100);
+  rollup_check("updating a parent");
+
+  cprogress_detachthread(&rollup_cprogress, 5);
+  rollup_is_attached[5] = 0;
+  rollup_check("detaching");
+  rollup_update(4, 3, 4);
+  rollup_check("updating after detaching");
+  cprogress_detachthread(&rollup_cprogress, 4);
+  rollup_is_attached[4] = 0;
+  rollup_check("detaching the last child");
+
+  cprogress_attachthread(&rollup_cprogress, 5, 3, rollup_weights[5]);
+  rollup_is_attached[5] = 1;
+  cprogress_attachthread(&rollup_cprogress, 4, 3, rollup_weights[4]);
+  rollup_is_attached[4] = 1;
+  rollup_check("attaching again");
+
+  /* all leaves updated at once, the sums must not drift */
+  pthread_t threads[ROLLUP_THREAD_COUNT];
+  const int leaves[] = { 1, 2, 4, 5 };
+  for (int i = 0; i < 4; ++i) pthread_create(&threads[i], NULL, rollup_worker, (void *) (intptr_t) leaves[i]);
+  for (int i = 0; i < 4; ++i) pthread_join(threads[i], NULL);
+  rollup_check("updating concurrently");
+
+  cprogress_destroy(&rollup_cprogress);
+  return check_end("parents at the weighted sum of their children");
+}
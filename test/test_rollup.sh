@@ -0,0 +1,5 @@
+#!/bin/sh
+
+# nested threads, a parent checked against the weighted sum of its children
+gcc -o test_rollup -g test_rollup.c -pthread -lm &&
+./test_rollup
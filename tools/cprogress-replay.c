@@ -0,0 +1,295 @@
+#include "stdio.h"
+#include "stdlib.h"
+#include "string.h"
+#include "time.h"
+
+#define CPROGRESS_IMPL
+#include "../cprogress.h"
+
+
+/*
+  cprogress-replay: draws a record of cprogress_enablerecord(...) again, as it went
+
+  | gcc -O2 -o cprogress-replay cprogress-replay.c
+  | ./cprogress-replay [-s speed] [-r fps] [-f format] file
+
+  [speed] is how many times faster than it was recorded (fractions slow it down), with the
+  formats in the record, [format] replacing the one it was created with. Rates, eta and elapsed time are of the
+  recorded time, not of the replay. A record cut short, e.g. by a crash, plays up to where
+  it ends.
+*/
+
+
+#define REPLAY_DEFAULT_FPS 30
+#define REPLAY_BASE_NS 1000000000ULL /* frame time of the start of the record */
+
+typedef struct {
+  const char *begin; /* the whole file */
+  const char *cursor;
+  const char *end;
+
+  uint64_t steps;
+  uint64_t started_ms; /* wall clock */
+  size_t formats_length;
+  cprogress_format_t *formats; /* in the order they were attached, chunks in displaychunks */
+  cprogress_displaychunk_t *displaychunks;
+  uint64_t frame_us; /* of the frame just read, since the start */
+  int max_index;
+  struct replay_slot *slots;
+
+  cprogress_t cprogress;
+} replay_t;
+
+#define replay_getvarint(rp, value) cprogress_getvarint(&(rp)->cursor, (rp)->end, value)
+
+int replay_load(replay_t *rp, const char *path) {
+  FILE *file = fopen(path, "rb");
+  if (!file) return 0;
+  fseek(file, 0, SEEK_END);
+  long size = ftell(file);
+  fseek(file, 0, SEEK_SET);
+  char *buf = size >= 0? (char *) malloc(size + 1): NULL;
+  int is_read = buf && fread(buf, 1, size, file) == size;
+  fclose(file);
+  if (!is_read) {
+    free(buf);
+    return 0;
+  }
+
+  rp->begin = rp->cursor = buf;
+  rp->end = buf + size;
+  return 1;
+}
+
+/* [chunks_length] chunks into [displaychunks], with room for the terminating one */
+int replay_readchunks(replay_t *rp, cprogress_displaychunk_t *displaychunks, uint64_t chunks_length) {
+  int has_autospan = 0;
+  for (uint64_t i = 0; i < chunks_length; ++i) {
+    cprogress_displaychunk_t *displaychunk = &displaychunks[i];
+    uint64_t type, span_width, is_autospan, value;
+    if (!replay_getvarint(rp, &type) || !replay_getvarint(rp, &span_width) || !replay_getvarint(rp, &is_autospan)) return 0;
+    if (!type || type >= CPROGRESS_DISPLAYCHUNK_TYPE_LENGTH) return 0;
+    if (is_autospan && has_autospan) return 0;
+    has_autospan |= is_autospan != 0;
+    displaychunk->type = type;
+    displaychunk->span_width = span_width - 1;
+    displaychunk->is_autospan = is_autospan;
+
+    if (type == CPROGRESS_DISPLAYCHUNK_LITERAL) {
+      if (!replay_getvarint(rp, &value) || value > rp->end - rp->cursor) return 0;
+      displaychunk->literal = rp->cursor;
+      displaychunk->literal_length = value;
+      rp->cursor += value;
+    } else if (type == CPROGRESS_DISPLAYCHUNK_BAR) {
+      if (!replay_getvarint(rp, &value)) return 0;
+      displaychunk->fill_char = value;
+    }
+  }
+  return 1;
+}
+
+/* magic, steps, time and the formats; literals point into the file */
+int replay_readheader(replay_t *rp) {
+  size_t magic_length = sizeof(CPROGRESS_RECORD_MAGIC) - 1;
+  if (rp->end - rp->cursor < magic_length || memcmp(rp->cursor, CPROGRESS_RECORD_MAGIC, magic_length)) return 0;
+  rp->cursor += magic_length;
+
+  uint64_t formats_length;
+  if (!replay_getvarint(rp, &rp->steps) || !rp->steps || !replay_getvarint(rp, &rp->started_ms) ||
+    !replay_getvarint(rp, &formats_length) || !formats_length || formats_length > CPROGRESS_FORMAT_MAXLEN) return 0;
+
+  /* every chunk takes a byte at least, so the rest of the file bounds them all */
+  size_t chunks_maxlen = rp->end - rp->cursor + formats_length;
+  rp->formats = (cprogress_format_t *) calloc(formats_length, sizeof(cprogress_format_t));
+  rp->displaychunks = (cprogress_displaychunk_t *) calloc(chunks_maxlen, sizeof(cprogress_displaychunk_t));
+  if (!rp->formats || !rp->displaychunks) return 0;
+
+  cprogress_displaychunk_t *displaychunk = rp->displaychunks;
+  for (uint64_t k = 0; k < formats_length; ++k) {
+    uint64_t chunks_length;
+    if (!replay_getvarint(rp, &chunks_length) || chunks_length > rp->end - rp->cursor) return 0;
+    rp->formats[k].displaychunks = displaychunk;
+    if (!replay_readchunks(rp, displaychunk, chunks_length)) return 0;
+    displaychunk += chunks_length + 1;
+
+    /* the same checks as for one given to cprogress_create_withchunks(...) */
+    rp->formats[k].refcount = 1;
+    if (cprogress_format_inspect(&rp->formats[k])) return 0;
+  }
+  rp->formats_length = formats_length;
+  return 1;
+}
+
+/* progress of a slot as the recorder has it, deltas are taken from it */
+typedef struct replay_slot {
+  int64_t step;
+  uint64_t done;
+  uint64_t total;
+} replay_slot_t;
+
+/*
+  one frame, applied to the instance when there is one, else only checked; zero at the end of
+  the record, or where it is cut short, the frame is then left out as a whole
+*/
+int replay_readframe(replay_t *rp, cprogress_t *cprogress) {
+  const char *frame_begin = rp->cursor;
+  for (int pass = 0; pass < (cprogress? 2: 1); ++pass) {
+    int is_applying = pass == 1;
+    rp->cursor = frame_begin;
+
+    uint64_t dt_us, index_delta;
+    if (!replay_getvarint(rp, &dt_us)) return 0;
+
+    int index = CPROGRESS_UNDEF;
+    while (1) {
+      if (!replay_getvarint(rp, &index_delta)) return 0;
+      if (!index_delta) break;
+      index += index_delta;
+      if (index < 0 || index > 1 << 28) return 0;
+      if (index > rp->max_index) rp->max_index = index;
+
+      uint64_t fields, value, title_length = 0, is_indeterminate = 0, parent = 0, weight = 0, format_index = 0;
+      int64_t step_delta = 0, done_delta = 0;
+      const char *title = NULL;
+      replay_slot_t slot = is_applying? rp->slots[index]: (replay_slot_t) {};
+      if (!replay_getvarint(rp, &fields)) return 0;
+      if (fields & CPROGRESS_RECORD_START) slot = (replay_slot_t) {};
+
+      if (fields & CPROGRESS_RECORD_TITLE) {
+        if (!replay_getvarint(rp, &title_length) || title_length > rp->end - rp->cursor) return 0;
+        title = rp->cursor;
+        rp->cursor += title_length;
+      }
+      if (fields & CPROGRESS_RECORD_STEP) {
+        if (!replay_getvarint(rp, &value)) return 0;
+        step_delta = _cprogress_unzigzag(value);
+      }
+      if (fields & CPROGRESS_RECORD_DONE) {
+        if (!replay_getvarint(rp, &value)) return 0;
+        done_delta = _cprogress_unzigzag(value);
+      }
+      if (fields & CPROGRESS_RECORD_TOTAL && !replay_getvarint(rp, &slot.total)) return 0;
+      if (fields & CPROGRESS_RECORD_INDETERMINATE && !replay_getvarint(rp, &is_indeterminate)) return 0;
+      if (fields & CPROGRESS_RECORD_PARENT) {
+        if (!replay_getvarint(rp, &parent) || !replay_getvarint(rp, &weight) || parent > 1 << 28) return 0;
+        if ((int) parent - 1 > rp->max_index) rp->max_index = parent - 1;
+      }
+      if (fields & CPROGRESS_RECORD_FORMAT && !replay_getvarint(rp, &format_index)) return 0;
+      /* from a later version, one varint each */
+      for (uint64_t unknown = fields & ~(uint64_t) CPROGRESS_RECORD_KNOWNFIELDS; unknown; unknown &= unknown - 1) {
+        if (!replay_getvarint(rp, &value)) return 0;
+      }
+      if (!is_applying) continue;
+
+      /* in the order an updater would have done it */
+      cprogress_threadinfo_t *threadinfo = &cprogress_getthreadinfo(cprogress, index);
+      if (fields & CPROGRESS_RECORD_START) {
+        /* the run before stopped in between two frames */
+        if (threadinfo->is_running) cprogress_threadinfo_abort(threadinfo);
+        cprogress_threadinfo_start(threadinfo);
+      }
+      if (fields & CPROGRESS_RECORD_PARENT) {
+        if (parent) cprogress_attachthread(cprogress, index, parent - 1, weight);
+        else cprogress_detachthread(cprogress, index);
+      }
+      if (title) {
+        char buf[CPROGRESS_TITLE_MAXLEN];
+        size_t length = title_length < CPROGRESS_TITLE_MAXLEN? title_length: CPROGRESS_TITLE_MAXLEN - 1;
+        memcpy(buf, title, length);
+        buf[length] = 0;
+        cprogress_threadinfo_updatetitle(threadinfo, buf);
+      }
+      if (fields & CPROGRESS_RECORD_INDETERMINATE) cprogress_threadinfo_updateindeterminate(threadinfo, is_indeterminate);
+      /* one past those in the header is drawn with the first */
+      if (fields & CPROGRESS_RECORD_FORMAT) cprogress_threadinfo_updateformat(threadinfo, format_index);
+
+      slot.done += done_delta;
+      slot.step += step_delta;
+      if (fields & CPROGRESS_RECORD_DONE && slot.total)
+        slot.step = slot.done >= slot.total? rp->steps: slot.done * rp->steps / slot.total;
+      if (fields & (CPROGRESS_RECORD_DONE | CPROGRESS_RECORD_TOTAL))
+        cprogress_threadinfo_updateprogress(threadinfo, slot.done, slot.total);
+      if (fields & CPROGRESS_RECORD_STEP)
+        cprogress_threadinfo_updatepercentage(threadinfo, slot.step * 100.0 / rp->steps);
+      if (fields & CPROGRESS_RECORD_STOP) cprogress_threadinfo_abort(threadinfo);
+      rp->slots[index] = slot;
+    }
+    if (pass == (cprogress? 1: 0)) rp->frame_us += dt_us;
+  }
+  return 1;
+}
+
+/* when the next frame is due, or right away when there is none so that the end is found */
+uint64_t replay_peekframe(const replay_t *rp) {
+  const char *cursor = rp->cursor;
+  uint64_t dt_us;
+  return cprogress_getvarint(&cursor, rp->end, &dt_us)? rp->frame_us + dt_us: 0;
+}
+
+void replay_usage() {
+  fprintf(stderr, "usage: cprogress-replay [-s speed] [-r fps] [-f format] file\n");
+}
+
+int main(int argc, char **argv) {
+  double speed = 1;
+  int fps = REPLAY_DEFAULT_FPS;
+  const char *fmt = NULL;
+  int i = 1;
+  for (; i < argc - 1 && argv[i][0] == '-'; i += 2) {
+    if (!strcmp(argv[i], "-s")) speed = atof(argv[i + 1]);
+    else if (!strcmp(argv[i], "-r")) fps = atoi(argv[i + 1]);
+    else if (!strcmp(argv[i], "-f")) fmt = argv[i + 1];
+    else break;
+  }
+  if (i != argc - 1 || speed <= 0 || fps <= 0) {
+    replay_usage();
+    return 2;
+  }
+
+  replay_t rp = {};
+  if (!replay_load(&rp, argv[i])) {
+    perror(argv[i]);
+    return 1;
+  }
+  if (!replay_readheader(&rp)) {
+    fprintf(stderr, "cprogress-replay: %s: not a record of cprogress_enablerecord(...)\n", argv[i]);
+    return 1;
+  }
+
+  /* slots to have, from a first pass */
+  const char *frames_begin = rp.cursor;
+  rp.max_index = CPROGRESS_UNDEF;
+  while (replay_readframe(&rp, NULL));
+  rp.cursor = frames_begin;
+  rp.frame_us = 0;
+
+  rp.slots = (replay_slot_t *) calloc(rp.max_index + 1, sizeof(replay_slot_t));
+  rp.cprogress = fmt? cprogress_create(fmt, rp.max_index + 1): cprogress_create_withchunks(rp.displaychunks, rp.max_index + 1);
+  if (rp.cprogress.error || !rp.slots) {
+    fprintf(stderr, "cprogress-replay: error occured with code %d\n", rp.cprogress.error);
+    return 1;
+  }
+  /* the same format_index as when recording */
+  for (size_t k = 1; k < rp.formats_length; ++k) cprogress_attachformat(&rp.cprogress, &rp.formats[k]);
+
+  time_t started = rp.started_ms / 1000;
+  fprintf(stderr, "recorded at %s", ctime(&started));
+
+  /* frames are applied as the replay clock passes them, and drawn at our own frame rate */
+  uint64_t begin_ns = cprogress_getnanotime();
+  int is_ended = 0;
+  while (!is_ended) {
+    uint64_t replay_us = (cprogress_getnanotime() - begin_ns) / 1e3 * speed;
+    while (!is_ended && replay_peekframe(&rp) <= replay_us) is_ended = !replay_readframe(&rp, &rp.cprogress);
+
+    cprogress_renderat(&rp.cprogress, REPLAY_BASE_NS + (is_ended? rp.frame_us: replay_us) * 1000);
+    if (!is_ended) cprogress_waitfps(fps);
+  }
+
+  cprogress_destroy(&rp.cprogress);
+  free(rp.slots);
+  free(rp.formats);
+  free(rp.displaychunks);
+  free((void *) rp.begin);
+  return 0;
+}
@@ -0,0 +1,176 @@
+#include "errno.h"
+#include "fcntl.h"
+#include "signal.h"
+#include "stdio.h"
+#include "stdlib.h"
+#include "string.h"
+#include "unistd.h"
+
+#include "sys/mman.h"
+#include "sys/stat.h"
+
+#define CPROGRESS_IMPL
+#include "../cprogress.h"
+
+
+/*
+  cprogress-top: watches the progress of another process from another shell
+
+  | gcc -O2 -o cprogress-top cprogress-top.c
+  | ./cprogress-top [-r fps] [-f format] name
+
+  [name] is what the process passed to cprogress_create_named(...). The segment is mapped
+  read-only, slots are copied into an instance of our own once per frame and drawn from there,
+  so the process being watched doesn't do anything for it, nor can it be disturbed. It quits
+  when the process is gone.
+*/
+
+
+#define TOP_DEFAULT_FPS 10
+#define TOP_DEFAULT_FORMAT "$=t [$40b#] $p% $c $r eta $e"
+
+typedef struct {
+  const cprogress_threadinfo_t *threadinfos; /* in the segment, read-only */
+  size_t threadinfos_length;
+  pid_t pid;
+
+  cprogress_t cprogress; /* ours, same slots */
+  uint32_t *start_counts; /* seen in the segment, per slot */
+} top_t;
+
+int top_is_stopping = 0;
+
+void top_onsignal(int sig) {
+  (void) sig;
+  top_is_stopping = 1;
+}
+
+/* NULL with errno set when it isn't there or is not one made by this very cprogress.h */
+const cprogress_sharedheader_t *top_map(const char *name, size_t *size) {
+  int fd = shm_open(name, O_RDONLY, 0);
+  if (fd < 0) return NULL;
+
+  struct stat st;
+  void *segment = fstat(fd, &st) || st.st_size < sizeof(cprogress_sharedheader_t)? MAP_FAILED:
+    mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (segment == MAP_FAILED) {
+    errno = EINVAL;
+    return NULL;
+  }
+
+  const cprogress_sharedheader_t *header = (const cprogress_sharedheader_t *) segment;
+  if (__atomic_load_n(&header->magic, __ATOMIC_ACQUIRE) != CPROGRESS_SHARED_MAGIC ||
+    header->threadinfo_size != sizeof(cprogress_threadinfo_t) ||
+    header->threadinfos_offset + header->threadinfos_length * sizeof(cprogress_threadinfo_t) > st.st_size) {
+    munmap(segment, st.st_size);
+    errno = EPROTO;
+    return NULL;
+  }
+
+  *size = st.st_size;
+  return header;
+}
+
+/* one slot of the segment into ours, through the same calls an updater would make */
+void top_copythread(top_t *top, int thread_index) {
+  const cprogress_threadinfo_t *source = &top->threadinfos[thread_index];
+  cprogress_threadinfo_t *threadinfo = &cprogress_getthreadinfo(&top->cprogress, thread_index);
+
+  cprogress_threadsnapshot_t snapshot;
+  cprogress_threadinfo_snapshot(source, &snapshot);
+
+  if (snapshot.start_count != top->start_counts[thread_index]) {
+    top->start_counts[thread_index] = snapshot.start_count;
+    /* what has already finished before we looked is not shown */
+    if (!snapshot.is_running && !threadinfo->is_running) return;
+    cprogress_threadinfo_start(threadinfo);
+  }
+  if (!threadinfo->is_running) return;
+
+  uint32_t parent = __atomic_load_n(&source->parent, __ATOMIC_ACQUIRE);
+  if (parent != threadinfo->parent) {
+    if (parent) cprogress_attachthread(&top->cprogress, thread_index, parent - 1, __atomic_load_n(&source->weight, __ATOMIC_RELAXED));
+    else cprogress_detachthread(&top->cprogress, thread_index);
+  }
+
+  if (strcmp(threadinfo->title, snapshot.title)) cprogress_threadinfo_updatetitle(threadinfo, snapshot.title);
+  if (threadinfo->is_indeterminate != snapshot.is_indeterminate)
+    cprogress_threadinfo_updateindeterminate(threadinfo, snapshot.is_indeterminate);
+  /* we are the only updater of ours */
+  __atomic_store_n(&threadinfo->tick_count, snapshot.tick_count, __ATOMIC_RELAXED);
+  /* a parent rolls up from our own children */
+  if (!snapshot.is_parent) {
+    if (snapshot.total || snapshot.done) cprogress_threadinfo_updateprogress(threadinfo, snapshot.done, snapshot.total);
+    if (!snapshot.total) cprogress_threadinfo_updatepercentage(threadinfo, snapshot.percentage);
+  }
+  if (!snapshot.is_running) cprogress_threadinfo_abort(threadinfo);
+}
+
+int top_isalive(pid_t pid) {
+  return !kill(pid, 0) || errno == EPERM;
+}
+
+void top_usage() {
+  fprintf(stderr, "usage: cprogress-top [-r fps] [-f format] name\n");
+}
+
+int main(int argc, char **argv) {
+  int fps = TOP_DEFAULT_FPS;
+  const char *fmt = TOP_DEFAULT_FORMAT;
+  int opt;
+  while ((opt = getopt(argc, argv, "r:f:h")) != -1) {
+    switch (opt) {
+    case 'r':
+      fps = atoi(optarg);
+      break;
+    case 'f':
+      fmt = optarg;
+      break;
+    default:
+      top_usage();
+      return opt == 'h'? 0: 2;
+    }
+  }
+  if (optind != argc - 1 || fps <= 0) {
+    top_usage();
+    return 2;
+  }
+  const char *name = argv[optind];
+
+  size_t segment_size;
+  const cprogress_sharedheader_t *header = top_map(name, &segment_size);
+  if (!header) {
+    fprintf(stderr, "cprogress-top: %s: %s\n", name,
+      errno == EPROTO? "not made by a matching cprogress.h": strerror(errno));
+    return 1;
+  }
+
+  top_t top = {
+    .threadinfos = (const cprogress_threadinfo_t *) ((const char *) header + header->threadinfos_offset),
+    .threadinfos_length = header->threadinfos_length,
+    .pid = header->pid,
+    .cprogress = cprogress_create(fmt, header->threadinfos_length),
+    .start_counts = (uint32_t *) calloc(header->threadinfos_length + 1, sizeof(uint32_t))
+  };
+  if (top.cprogress.error || !top.start_counts) {
+    fprintf(stderr, "cprogress-top: error occured with code %d\n", top.cprogress.error);
+    return 1;
+  }
+
+  signal(SIGINT, top_onsignal);
+  signal(SIGTERM, top_onsignal);
+
+  while (!top_is_stopping) {
+    int is_alive = top_isalive(top.pid);
+    for (size_t i = 0; i < top.threadinfos_length; ++i) top_copythread(&top, i);
+    cprogress_render(&top.cprogress);
+    if (!is_alive) break;
+    cprogress_waitfps(fps);
+  }
+
+  cprogress_destroy(&top.cprogress);
+  free(top.start_counts);
+  munmap((void *) header, segment_size);
+  return 0;
+}